@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "bimap.h"
+#include "test-classes.h"
+#include <benchmark/benchmark.h>
+
+// Scales are kept at 1k..1M by default so a full run fits in CI; pass
+// --benchmark_filter and wider ranges locally for the 100M-scale numbers.
+
+namespace {
+
+constexpr uint32_t bench_seed = 1488228;
+
+std::vector<std::pair<uint32_t, uint32_t>> random_pairs(size_t n) {
+  std::mt19937 e(bench_seed);
+  std::vector<std::pair<uint32_t, uint32_t>> res(n);
+  for (auto &p : res) {
+    p = {e(), e()};
+  }
+  return res;
+}
+
+bimap<uint32_t, uint32_t> filled_bimap(size_t n) {
+  auto data = random_pairs(n);
+  return bimap<uint32_t, uint32_t>(data.begin(), data.end());
+}
+
+bimap<uint32_t, uint32_t>
+filled_bimap(std::vector<std::pair<uint32_t, uint32_t>> const &data) {
+  bimap<uint32_t, uint32_t> b;
+  for (auto const &p : data) {
+    b.insert(p.first, p.second);
+  }
+  return b;
+}
+
+bimap<uint32_t, uint32_t>::left_iterator
+bimap_ctor_helper(bimap<uint32_t, uint32_t> &b, uint32_t l, uint32_t r) {
+  return b.insert(l, r);
+}
+
+void bm_insert_random(benchmark::State &state) {
+  auto data = random_pairs(state.range(0));
+  for (auto _ : state) {
+    bimap<uint32_t, uint32_t> b;
+    for (auto const &p : data) {
+      benchmark::DoNotOptimize(bimap_ctor_helper(b, p.first, p.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bm_insert_random)->Range(1 << 10, 1 << 20);
+
+void bm_insert_sorted(benchmark::State &state) {
+  auto data = random_pairs(state.range(0));
+  std::sort(data.begin(), data.end());
+  for (auto _ : state) {
+    bimap<uint32_t, uint32_t> b;
+    for (auto const &p : data) {
+      benchmark::DoNotOptimize(bimap_ctor_helper(b, p.first, p.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bm_insert_sorted)->Range(1 << 10, 1 << 20);
+
+// descending keys: every insert lands at the far left of both trees
+void bm_insert_adversarial(benchmark::State &state) {
+  auto data = random_pairs(state.range(0));
+  std::sort(data.begin(), data.end(), std::greater<>());
+  for (auto _ : state) {
+    bimap<uint32_t, uint32_t> b;
+    for (auto const &p : data) {
+      benchmark::DoNotOptimize(bimap_ctor_helper(b, p.first, p.second));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bm_insert_adversarial)->Range(1 << 10, 1 << 20);
+
+void bm_insert_bulk(benchmark::State &state) {
+  auto data = random_pairs(state.range(0));
+  for (auto _ : state) {
+    auto batch = data;
+    bimap<uint32_t, uint32_t> b;
+    benchmark::DoNotOptimize(b.insert(std::move(batch)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bm_insert_bulk)->Range(1 << 10, 1 << 20);
+
+void bm_find_hit(benchmark::State &state) {
+  auto data = random_pairs(state.range(0));
+  auto b = filled_bimap(data);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(b.find_left(data[i].first));
+    benchmark::DoNotOptimize(b.find_right(data[i].second));
+    i = (i + 1) % data.size();
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(bm_find_hit)->Range(1 << 10, 1 << 20);
+
+void bm_find_miss(benchmark::State &state) {
+  auto b = filled_bimap(state.range(0));
+  std::mt19937 e(bench_seed + 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(b.find_left(e()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bm_find_miss)->Range(1 << 10, 1 << 20);
+
+void bm_lower_bound(benchmark::State &state) {
+  auto b = filled_bimap(state.range(0));
+  std::mt19937 e(bench_seed + 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(b.lower_bound_left(e()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bm_lower_bound)->Range(1 << 10, 1 << 20);
+
+// 90% find_left, 10% insert/erase of random pairs
+void bm_mixed_read_write(benchmark::State &state) {
+  auto b = filled_bimap(state.range(0));
+  std::mt19937 e(bench_seed + 3);
+  for (auto _ : state) {
+    uint32_t op = e() % 10;
+    if (op == 0) {
+      b.insert(e(), e());
+    } else if (op == 1) {
+      b.erase_left(e());
+    } else {
+      benchmark::DoNotOptimize(b.find_left(e()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bm_mixed_read_write)->Range(1 << 10, 1 << 20);
+
+void bm_iteration(benchmark::State &state) {
+  auto b = filled_bimap(state.range(0));
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+      sum += *it;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bm_iteration)->Range(1 << 10, 1 << 20);
+
+void bm_copy_construction(benchmark::State &state) {
+  auto b = filled_bimap(state.range(0));
+  for (auto _ : state) {
+    bimap<uint32_t, uint32_t> copy(b);
+    benchmark::DoNotOptimize(copy.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(bm_copy_construction)->Range(1 << 10, 1 << 18);
+
+// non-trivial comparator with keys the comparator has to chase: every
+// comparison does floating-point work on both operands
+void bm_find_vector_compare(benchmark::State &state) {
+  using vec = std::pair<int, int>;
+  bimap<vec, vec, vector_compare, vector_compare> b;
+  std::mt19937 e(bench_seed + 4);
+  std::vector<vec> keys;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    vec l{static_cast<int>(e() % 100000), static_cast<int>(e() % 100000)};
+    vec r{static_cast<int>(e() % 100000), static_cast<int>(e() % 100000)};
+    if (b.insert(l, r) != b.end_left()) {
+      keys.push_back(l);
+    }
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(b.find_left(keys[i]));
+    i = (i + 1) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(bm_find_vector_compare)->Range(1 << 10, 1 << 16);
+
+} // namespace
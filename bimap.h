@@ -1,15 +1,100 @@
 #pragma once
 
 #include "treap.h"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <set>
 #include <stdexcept>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+// Политика с опциональными ускорителями bimap. Наследуйтесь от нее и
+// переопределяйте флаги, чтобы включать режимы по отдельности.
+struct bimap_default_policy {
+  // поддерживать хеш-индексы обоих сторон для O(1) точного поиска;
+  // требует std::hash и operator== для ключей
+  static constexpr bool hash_index = false;
+
+  // начинать find/lower_bound от последнего найденного узла (finger search):
+  // O(log d) для расстояния d между соседними запросами вместо спуска от
+  // корня. Выгодно при локальных обращениях; кеш пальца мутабелен, поэтому
+  // даже const-поиски в этом режиме нельзя делить между потоками
+  static constexpr bool finger_search = false;
+
+  // вести счетчики операций, аллокаций и вызовов компараторов (bimap::stats());
+  // выключенные счетчики компилируются в ничто
+  static constexpr bool stats = false;
+};
+
+struct with_hash_index : bimap_default_policy {
+  static constexpr bool hash_index = true;
+};
+
+struct with_finger_search : bimap_default_policy {
+  static constexpr bool finger_search = true;
+};
+
+struct with_stats : bimap_default_policy {
+  static constexpr bool stats = true;
+};
+
+// Счетчики bimap::stats() (политика with_stats): операции, аллокации и
+// вызовы компараторов с момента создания контейнера.
+struct bimap_stats {
+  std::uint64_t finds = 0;
+  std::uint64_t inserts = 0;
+  std::uint64_t erases = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t deallocations = 0;
+  std::uint64_t comparisons_left = 0;
+  std::uint64_t comparisons_right = 0;
+  std::size_t live_nodes = 0;
+};
+
+// Результат bimap::depth_stats_*(): распределение глубин узлов дерева.
+// histogram[d] — число узлов на глубине d (корень — глубина 0).
+struct bimap_depth_stats {
+  std::vector<std::uint64_t> histogram;
+  std::size_t max_depth = 0;
+  double avg_depth = 0.0;
+};
+
+// Компаратор-обертка, считающая вызовы; живет внутри treap_storage при
+// политике with_stats, так что счетчик переезжает вместе с деревом
+template <typename Compare> struct counting_compare : Compare {
+  mutable std::uint64_t count = 0;
+
+  counting_compare() = default;
+  explicit counting_compare(Compare cmp) : Compare(std::move(cmp)) {}
+
+  template <typename A, typename B>
+  bool operator()(A const &a, B const &b) const {
+    ++count;
+    return Compare::operator()(a, b);
+  }
+};
+
+// Результат diff(a, b): какие пары добавить и удалить, чтобы из a получить b.
+template <typename Left, typename Right> struct bimap_diff {
+  std::vector<std::pair<Left, Right>> added;
+  std::vector<std::pair<Left, Right>> removed;
+};
 
 template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
-          typename CompareRight = std::less<Right>>
+          typename CompareRight = std::less<Right>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>,
+          typename Policy = bimap_default_policy>
 struct bimap {
   using left_t = Left;
   using right_t = Right;
+  using allocator_type = Allocator;
 
   struct tag_right;
   struct tag_left;
@@ -30,7 +115,13 @@ private:
   using tag_other = std::conditional_t<is_left<Tag>, tag_right, tag_left>;
 
   template <typename Tag>
-  using compare_t = std::conditional_t<is_left<Tag>, CompareLeft, CompareRight>;
+  using raw_compare_t =
+      std::conditional_t<is_left<Tag>, CompareLeft, CompareRight>;
+
+  template <typename Tag>
+  using compare_t = std::conditional_t<Policy::stats,
+                                       counting_compare<raw_compare_t<Tag>>,
+                                       raw_compare_t<Tag>>;
 
   template <typename Tag>
   using treap_t = treap<key_t<Tag>, compare_t<Tag>, Tag>;
@@ -50,8 +141,26 @@ private:
 
     node_t(left_t l, right_t r)
         : key_left(std::move(l)), key_right(std::move(r)) {}
+
+    template <typename... ArgsL, typename... ArgsR>
+    node_t(std::piecewise_construct_t, std::tuple<ArgsL...> args_left,
+           std::tuple<ArgsR...> args_right)
+        : key_left(std::make_from_tuple<left_t>(std::move(args_left))),
+          key_right(std::make_from_tuple<right_t>(std::move(args_right))) {}
   };
 
+  using node_allocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<node_t>;
+  using node_alloc_traits = std::allocator_traits<node_allocator>;
+
+  // detects pool-style allocators that can drop all storage at once
+  template <typename A, typename = void>
+  struct has_release_all : std::false_type {};
+  template <typename A>
+  struct has_release_all<
+      A, std::void_t<decltype(std::declval<A &>().release_all())>>
+      : std::true_type {};
+
   // note: I know that lambdas should be generally faster for this, but I faced
   // what appears to be a gcc bug very similar to this:
   // http://www.cplusplus.com/forum/beginner/130564/
@@ -64,7 +173,121 @@ private:
     }
   }
 
+  // open-addressing index over one key side: node pointers hashed by key,
+  // linear probing, tombstone deletion, amortized rehash at 70% load. Only
+  // instantiated when the policy asks for it, so keys of plain bimaps do
+  // not need std::hash or operator==
+  template <typename Tag> struct hash_index_t {
+    std::vector<node_t *> slots;
+    std::vector<char> state; // 0 empty, 1 full, 2 tombstone
+    std::size_t full = 0;    // live entries
+    std::size_t used = 0;    // live entries + tombstones
+
+    static std::size_t hash(key_t<Tag> const &key) {
+      return std::hash<key_t<Tag>>{}(key);
+    }
+
+    static key_t<Tag> const &key_of(node_t *node) {
+      return key_getter<Tag>(static_cast<node_<Tag> *>(node));
+    }
+
+    node_t *find(key_t<Tag> const &key) const {
+      if (full == 0) {
+        return nullptr;
+      }
+      std::size_t mask = slots.size() - 1;
+      for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+        if (state[i] == 0) {
+          return nullptr;
+        }
+        if (state[i] == 1 && key_of(slots[i]) == key) {
+          return slots[i];
+        }
+      }
+    }
+
+    void insert(node_t *node) {
+      if ((used + 1) * 10 >= slots.size() * 7) {
+        rehash();
+      }
+      std::size_t mask = slots.size() - 1;
+      std::size_t i = hash(key_of(node)) & mask;
+      while (state[i] == 1) {
+        i = (i + 1) & mask;
+      }
+      if (state[i] == 0) {
+        used++;
+      }
+      slots[i] = node;
+      state[i] = 1;
+      full++;
+    }
+
+    void erase(key_t<Tag> const &key) {
+      if (full == 0) {
+        return;
+      }
+      std::size_t mask = slots.size() - 1;
+      for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+        if (state[i] == 0) {
+          return;
+        }
+        if (state[i] == 1 && key_of(slots[i]) == key) {
+          state[i] = 2;
+          full--;
+          return;
+        }
+      }
+    }
+
+    void clear() {
+      slots.clear();
+      state.clear();
+      full = used = 0;
+    }
+
+    void rehash() {
+      std::vector<node_t *> old = std::move(slots);
+      std::vector<char> old_state = std::move(state);
+      // size so the table lands at <= 35% load and insertions below cannot
+      // re-enter rehash
+      std::size_t cap = 16;
+      while (cap * 7 < (full + 1) * 20) {
+        cap *= 2;
+      }
+      slots.assign(cap, nullptr);
+      state.assign(cap, 0);
+      full = 0;
+      used = 0;
+      for (std::size_t i = 0; i < old.size(); i++) {
+        if (old_state[i] == 1) {
+          insert(old[i]);
+        }
+      }
+    }
+  };
+
+  struct no_index {};
+  struct no_stats {};
+
+  // finds is mutable because the lookup chokepoints are const
+  struct op_counters {
+    mutable std::uint64_t finds = 0;
+    std::uint64_t inserts = 0;
+    std::uint64_t erases = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t deallocations = 0;
+  };
+
   template <typename Tag> struct iterator {
+    // полноценный bidirectional iterator: с этими typedef'ами итераторы
+    // принимают std::for_each, std::distance, range-for и ranges
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = key_t<Tag>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = key_t<Tag> const *;
+    using reference = key_t<Tag> const &;
+
     iterator(const iterator &other) : node(other.node) {}
 
     iterator &operator=(const iterator &other) {
@@ -91,6 +314,10 @@ private:
       return key_getter<Tag>(node);
     }
 
+    key_t<Tag> const *operator->() const noexcept {
+      return &key_getter<Tag>(node);
+    }
+
     // Переход к следующему по величине left'у.
     // Инкремент итератора end_left() неопределен.
     // Инкремент невалидного итератора неопределен.
@@ -142,16 +369,262 @@ public:
   using left_iterator = iterator<tag_left>;
   using right_iterator = iterator<tag_right>;
 
+  // итераторы и так не дают менять ключи (это сломало бы деревья), поэтому
+  // const-варианты совпадают с обычными
+  using const_left_iterator = left_iterator;
+  using const_right_iterator = right_iterator;
+
   // Создает bimap не содержащий ни одной пары.
   explicit bimap(CompareLeft compare_left = CompareLeft(),
-                 CompareRight compare_right = CompareRight())
-      : treap_left(std::move(compare_left),
+                 CompareRight compare_right = CompareRight(),
+                 Allocator alloc = Allocator())
+      : treap_left(compare_t<tag_left>(std::move(compare_left)),
                    static_cast<node_left *>(&end_node)),
-        treap_right(std::move(compare_right),
-                    static_cast<node_right *>(&end_node)) {
+        treap_right(compare_t<tag_right>(std::move(compare_right)),
+                    static_cast<node_right *>(&end_node)),
+        alloc_(std::move(alloc)) {
     validate_ends();
   };
 
+  // Создает пустой bimap с заданным зерном генератора приоритетов.
+  // При одинаковом зерне и одинаковой последовательности операций деревья
+  // получают одинаковую форму — удобно для воспроизводимых бенчмарков.
+  explicit bimap(std::uint64_t priority_seed,
+                 CompareLeft compare_left = CompareLeft(),
+                 CompareRight compare_right = CompareRight(),
+                 Allocator alloc = Allocator())
+      : bimap(std::move(compare_left), std::move(compare_right),
+              std::move(alloc)) {
+    rng_ = priority_source(priority_seed);
+  }
+
+  // Создает bimap из ренжа пар (first, second -> left, right).
+  // Эквивалентен последовательности insert'ов в порядке возрастания left,
+  // но строится за O(n log n), а на отсортированном по left входе — за O(n).
+  template <typename InputIt>
+  bimap(InputIt first, InputIt last, CompareLeft compare_left = CompareLeft(),
+        CompareRight compare_right = CompareRight(),
+        Allocator alloc = Allocator())
+      : bimap(std::move(compare_left), std::move(compare_right),
+              std::move(alloc)) {
+    assign(first, last);
+  }
+
+  // Заменяет содержимое на пары из [first, last). Из пар с равными левыми
+  // или правыми ключами остается пара с меньшим left.
+  template <typename InputIt> void assign(InputIt first, InputIt last) {
+    std::vector<std::pair<left_t, right_t>> items(first, last);
+    batch_order order = dedup_batch(items);
+
+    std::vector<node_t *> by_left_nodes;
+    std::vector<node_right *> by_right_nodes;
+    build_batch_nodes(items, order, by_left_nodes, by_right_nodes);
+
+    // the replacement nodes were just carved from the same allocator, so the
+    // bulk release_all teardown of erase_all would free them too; the old
+    // contents have to go node by node
+    erase_left(begin_left(), end_left());
+    treap_left.assign_ordered(by_left_nodes.begin(), by_left_nodes.end());
+    treap_right.assign_ordered(by_right_nodes.begin(), by_right_nodes.end());
+    for (node_t *node : by_left_nodes) {
+      index_insert(node);
+    }
+    size_ = by_left_nodes.size();
+  }
+
+  // Пакетная вставка, эквивалентная последовательной вставке пар в порядке
+  // возрастания left. Возвращает число вставленных пар. Структурная работа —
+  // O(m log(n / m)) через объединение treap'ов, плюс m проверок уникальности.
+  std::size_t insert(std::vector<std::pair<left_t, right_t>> &&batch) {
+    auto left_less = [this](auto const &a, auto const &b) {
+      return treap_left.less(a.first, b.first);
+    };
+    if (!std::is_sorted(batch.begin(), batch.end(), left_less)) {
+      // stable, so of pairs with equal left the earlier one in the input wins
+      std::stable_sort(batch.begin(), batch.end(), left_less);
+    }
+
+    // a pair is dropped iff one of its keys is already in the map or belongs
+    // to an earlier accepted pair of this batch; equal lefts are adjacent
+    // after the sort, so one remembered index covers the left-key conflicts
+    batch_order order;
+    order.removed.assign(batch.size(), 0);
+    auto right_ptr_less = [this](const right_t *a, const right_t *b) {
+      return treap_right.less(*a, *b);
+    };
+    std::set<const right_t *, decltype(right_ptr_less)> taken_rights(
+        right_ptr_less);
+    std::size_t last_accepted = batch.size();
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      bool ok = (last_accepted == batch.size() ||
+                 left_less(batch[last_accepted], batch[i])) &&
+                !contains<tag_left>(batch[i].first) &&
+                !contains<tag_right>(batch[i].second) &&
+                taken_rights.insert(&batch[i].second).second;
+      if (ok) {
+        last_accepted = i;
+      } else {
+        order.removed[i] = 1;
+      }
+    }
+    order.by_right.resize(batch.size());
+    std::iota(order.by_right.begin(), order.by_right.end(), std::size_t(0));
+    auto right_less = [this, &batch](std::size_t a, std::size_t b) {
+      return treap_right.less(batch[a].second, batch[b].second);
+    };
+    if (!std::is_sorted(order.by_right.begin(), order.by_right.end(),
+                        right_less)) {
+      std::sort(order.by_right.begin(), order.by_right.end(), right_less);
+    }
+
+    std::vector<node_t *> by_left_nodes;
+    std::vector<node_right *> by_right_nodes;
+    build_batch_nodes(batch, order, by_left_nodes, by_right_nodes);
+    if (by_left_nodes.empty()) {
+      return 0;
+    }
+    treap_left.unite(treap_t<tag_left>::build_sorted(by_left_nodes.begin(),
+                                                     by_left_nodes.end()),
+                     &key_getter<tag_left>);
+    treap_right.unite(treap_t<tag_right>::build_sorted(by_right_nodes.begin(),
+                                                       by_right_nodes.end()),
+                      &key_getter<tag_right>);
+    // thread the merged nodes into both successor lists; ascending order
+    // guarantees a node's predecessor is already linked when relink runs
+    for (node_t *node : by_left_nodes) {
+      treap_left.relink(static_cast<node_left *>(node));
+    }
+    for (node_right *node : by_right_nodes) {
+      treap_right.relink(node);
+    }
+    for (node_t *node : by_left_nodes) {
+      index_insert(node);
+    }
+    stat_insert(by_left_nodes.size());
+    size_ += by_left_nodes.size();
+    return by_left_nodes.size();
+  }
+
+  template <typename InputIt>
+  std::size_t insert_batch(InputIt first, InputIt last) {
+    return insert(std::vector<std::pair<left_t, right_t>>(first, last));
+  }
+
+  // Перемещает в *this все пары из other, ни один из ключей которых здесь не
+  // занят; конфликтующие пары остаются в other. При равных аллокаторах узлы
+  // крадутся без перевыделения, структурная работа — объединение treap'ов за
+  // O(m log(n/m)); при неравных (например, два независимых пула) пары
+  // копируются поэлементно. Возвращает число перенесенных пар.
+  std::size_t merge(bimap &other) {
+    if (!(alloc_ == other.alloc_)) {
+      // a stolen node would later be freed through our allocator while its
+      // memory belongs to other's (pool_allocator compares by identity), so
+      // unequal allocators copy pairs instead of adopting nodes
+      std::size_t moved = 0;
+      for (left_iterator it = other.begin_left(); it != other.end_left();) {
+        if (insert(*it, *it.flip()) != end_left()) {
+          it = other.erase_left(it);
+          ++moved;
+        } else {
+          ++it;
+        }
+      }
+      return moved;
+    }
+    std::vector<node_t *> stolen_left;
+    std::vector<node_t *> kept_left;
+    for (left_iterator it = other.begin_left(); it != other.end_left(); ++it) {
+      auto *node = static_cast<node_t *>(it.node);
+      if (!contains<tag_left>(node->key_left) &&
+          !contains<tag_right>(node->key_right)) {
+        stolen_left.push_back(node);
+      } else {
+        kept_left.push_back(node);
+      }
+    }
+    if (stolen_left.empty()) {
+      return 0;
+    }
+    // the right-order walk tells stolen nodes apart by pointer search — no
+    // key comparisons and no per-node allocations
+    std::vector<node_t *> stolen_sorted = stolen_left;
+    std::sort(stolen_sorted.begin(), stolen_sorted.end());
+    std::vector<node_right *> stolen_right;
+    std::vector<node_right *> kept_right;
+    for (right_iterator it = other.begin_right(); it != other.end_right();
+         ++it) {
+      auto *node = static_cast<node_t *>(it.node);
+      if (std::binary_search(stolen_sorted.begin(), stolen_sorted.end(),
+                             node)) {
+        stolen_right.push_back(static_cast<node_right *>(node));
+      } else {
+        kept_right.push_back(static_cast<node_right *>(node));
+      }
+    }
+    // other keeps only the conflicting pairs; its trees are rebuilt linearly
+    other.index_clear();
+    other.treap_left.assign_ordered(kept_left.begin(), kept_left.end());
+    other.treap_right.assign_ordered(kept_right.begin(), kept_right.end());
+    for (node_t *node : kept_left) {
+      other.index_insert(node);
+    }
+    other.size_ = kept_left.size();
+
+    treap_left.unite(treap_t<tag_left>::build_sorted(stolen_left.begin(),
+                                                     stolen_left.end()),
+                     &key_getter<tag_left>);
+    treap_right.unite(treap_t<tag_right>::build_sorted(stolen_right.begin(),
+                                                       stolen_right.end()),
+                      &key_getter<tag_right>);
+    for (node_t *node : stolen_left) {
+      treap_left.relink(static_cast<node_left *>(node));
+    }
+    for (node_right *node : stolen_right) {
+      treap_right.relink(node);
+    }
+    for (node_t *node : stolen_left) {
+      index_insert(node);
+    }
+    stat_insert(stolen_left.size());
+    size_ += stolen_left.size();
+    return stolen_left.size();
+  }
+
+  std::size_t merge(bimap &&other) { return merge(other); }
+
+  // Diff в порядке left за O(n + m): пары, которых не хватает или которые
+  // лишние в *this относительно to. Пара с совпавшим left, но другим right
+  // попадает в оба списка (removed + added).
+  bimap_diff<left_t, right_t> diff_to(const bimap &to) const {
+    bimap_diff<left_t, right_t> res;
+    left_iterator it1 = begin_left();
+    left_iterator it2 = to.begin_left();
+    while (it1 != end_left() && it2 != to.end_left()) {
+      if (treap_left.less(*it1, *it2)) {
+        res.removed.emplace_back(*it1, *it1.flip());
+        ++it1;
+      } else if (treap_left.less(*it2, *it1)) {
+        res.added.emplace_back(*it2, *it2.flip());
+        ++it2;
+      } else {
+        if (treap_right.less(*it1.flip(), *it2.flip()) ||
+            treap_right.less(*it2.flip(), *it1.flip())) {
+          res.removed.emplace_back(*it1, *it1.flip());
+          res.added.emplace_back(*it2, *it2.flip());
+        }
+        ++it1;
+        ++it2;
+      }
+    }
+    for (; it1 != end_left(); ++it1) {
+      res.removed.emplace_back(*it1, *it1.flip());
+    }
+    for (; it2 != to.end_left(); ++it2) {
+      res.added.emplace_back(*it2, *it2.flip());
+    }
+    return res;
+  }
+
   // Конструкторы от других и присваивания
   bimap(bimap const &other)
       : treap_left(other.treap_left.get_cmp(),
@@ -160,7 +633,7 @@ public:
                     static_cast<node_right *>(&end_node)) {
     try {
       validate_ends();
-      insert_all(other);
+      clone_from(other);
     } catch (...) {
       erase_all();
       throw;
@@ -168,10 +641,14 @@ public:
   };
 
   bimap(bimap &&other) noexcept
-      : treap_left(std::move(other.treap_left)),
-        treap_right(std::move(other.treap_right)), size_(other.size_) {
+      : treap_left(other.treap_left.get_cmp(),
+                   static_cast<node_left *>(&end_node)),
+        treap_right(other.treap_right.get_cmp(),
+                    static_cast<node_right *>(&end_node)) {
+    // set up an empty map bound to our own end node, then trade contents;
+    // stealing other's treaps directly would leave both maps rooted there
     validate_ends();
-    other.validate_ends();
+    swap(other);
   };
 
   bimap &operator=(const bimap &other) {
@@ -212,6 +689,129 @@ public:
     return insert_impl(std::move(left), std::move(right));
   }
 
+  // Конструирует оба ключа из кортежей аргументов сразу в памяти узла
+  // (piecewise construct), без промежуточных объектов на стороне вызова.
+  // Уникальность проверяется по уже построенным ключам, поэтому при
+  // конфликте узел уничтожается и возвращается end_left().
+  template <typename... ArgsL, typename... ArgsR>
+  left_iterator emplace(std::tuple<ArgsL...> args_left,
+                        std::tuple<ArgsR...> args_right) {
+    node_t *node = make_node(std::piecewise_construct, std::move(args_left),
+                             std::move(args_right));
+    auto pos_l =
+        treap_left.find_insert_pos(node->key_left, &key_getter<tag_left>);
+    auto pos_r =
+        treap_right.find_insert_pos(node->key_right, &key_getter<tag_right>);
+    if (pos_l.found != nullptr || pos_r.found != nullptr) {
+      destroy_node(node);
+      return end_left();
+    }
+    treap_left.insert_at(pos_l, node);
+    treap_right.insert_at(pos_r, node);
+    index_insert(node);
+    stat_insert();
+    ++size_;
+    return left_iterator(node);
+  }
+
+  // Владеющая ручка на извлеченный из bimap узел: пара живет вне деревьев,
+  // ключи можно менять, а повторная вставка не перевыделяет память.
+  // Неповторно вставленный узел уничтожается деструктором ручки; вставка в
+  // bimap с другим (неравным) аллокатором копирует ключи вместо передачи
+  // узла.
+  class node_handle {
+    friend bimap;
+
+  public:
+    node_handle() = default;
+
+    node_handle(node_handle &&other) noexcept
+        : map_(other.map_), node_(other.node_) {
+      other.map_ = nullptr;
+      other.node_ = nullptr;
+    }
+
+    node_handle &operator=(node_handle &&other) noexcept {
+      if (this != &other) {
+        reset();
+        map_ = other.map_;
+        node_ = other.node_;
+        other.map_ = nullptr;
+        other.node_ = nullptr;
+      }
+      return *this;
+    }
+
+    node_handle(node_handle const &) = delete;
+    node_handle &operator=(node_handle const &) = delete;
+
+    ~node_handle() { reset(); }
+
+    [[nodiscard]] bool empty() const noexcept { return node_ == nullptr; }
+
+    left_t &left() const { return node_->key_left; }
+    right_t &right() const { return node_->key_right; }
+
+  private:
+    node_handle(bimap *map, node_t *node) : map_(map), node_(node) {}
+
+    void reset() {
+      if (node_ != nullptr) {
+        map_->destroy_node(node_);
+        node_ = nullptr;
+      }
+    }
+
+    bimap *map_ = nullptr;
+    node_t *node_ = nullptr;
+  };
+
+  // Извлекает пару из bimap, не уничтожая узел. Итератор инвалидируется,
+  // приоритеты узла сохраняются.
+  node_handle extract_left(left_iterator it) {
+    return extract(static_cast<node_t *>(it.node));
+  }
+
+  node_handle extract_right(right_iterator it) {
+    return extract(static_cast<node_t *>(it.node));
+  }
+
+  // Вставляет извлеченный узел обратно (возможно, с измененными ключами).
+  // При конфликте ключей возвращает end_left(), а узел остается в ручке.
+  left_iterator insert(node_handle &&nh) {
+    if (nh.empty()) {
+      return end_left();
+    }
+    if (nh.map_ != this && !(alloc_ == nh.map_->alloc_)) {
+      // the node belongs to another map's allocator and cannot be adopted
+      // (freeing it here would go through the wrong pool); copy the keys and
+      // let the handle destroy the node through its own map
+      left_iterator res = insert(nh.left(), nh.right());
+      if (res != end_left()) {
+        nh.reset();
+      }
+      return res;
+    }
+    auto pos_l =
+        treap_left.find_insert_pos(nh.node_->key_left, &key_getter<tag_left>);
+    if (pos_l.found != nullptr) {
+      return end_left();
+    }
+    auto pos_r = treap_right.find_insert_pos(nh.node_->key_right,
+                                             &key_getter<tag_right>);
+    if (pos_r.found != nullptr) {
+      return end_left();
+    }
+    node_t *node = nh.node_;
+    nh.node_ = nullptr;
+    treap_left.insert_at(pos_l, node);
+    treap_right.insert_at(pos_r, node);
+    index_insert(node);
+    stat_insert();
+    ++size_;
+    return left_iterator(node);
+  }
+
   // Удаляет элемент и соответствующий ему парный.
   // erase невалидного итератора неопределен.
   // erase(end_left()) и erase(end_right()) неопределены.
@@ -245,13 +845,50 @@ public:
     return erase_impl<tag_right>(first, last);
   }
 
-  // Возвращает итератор по элементу. Если не найден - соответствующий end()
+  // Возвращает итератор по элементу. Если не найден - соответствующий end().
+  // С политикой with_hash_index точный поиск идет через хеш-индекс за O(1),
+  // с with_finger_search спуск начинается от последнего найденного узла
   left_iterator find_left(left_t const &left) const {
-    return left_iterator(treap_left.find(left, &key_getter<tag_left>));
+    stat_find();
+    if constexpr (Policy::hash_index) {
+      node_t *node = hash_left_.find(left);
+      return node != nullptr ? left_iterator(static_cast<node_left *>(node))
+                             : end_left();
+    } else if constexpr (Policy::finger_search) {
+      return left_iterator(treap_left.find_finger(left, &key_getter<tag_left>));
+    } else {
+      return left_iterator(treap_left.find(left, &key_getter<tag_left>));
+    }
   }
 
   right_iterator find_right(right_t const &right) const {
-    return right_iterator(treap_right.find(right, &key_getter<tag_right>));
+    stat_find();
+    if constexpr (Policy::hash_index) {
+      node_t *node = hash_right_.find(right);
+      return node != nullptr ? right_iterator(static_cast<node_right *>(node))
+                             : end_right();
+    } else if constexpr (Policy::finger_search) {
+      return right_iterator(
+          treap_right.find_finger(right, &key_getter<tag_right>));
+    } else {
+      return right_iterator(treap_right.find(right, &key_getter<tag_right>));
+    }
+  }
+
+  // Гетерогенные версии поиска: участвуют в перегрузке только когда
+  // соответствующий компаратор помечен is_transparent (например, std::less<>).
+  // Позволяют искать по std::string_view и подобным типам, не материализуя
+  // ключ.
+  template <typename K, typename C = CompareLeft,
+            typename = typename C::is_transparent>
+  left_iterator find_left(K const &key) const {
+    return left_iterator(treap_left.find(key, &key_getter<tag_left>));
+  }
+
+  template <typename K, typename C = CompareRight,
+            typename = typename C::is_transparent>
+  right_iterator find_right(K const &key) const {
+    return right_iterator(treap_right.find(key, &key_getter<tag_right>));
   }
 
 private:
@@ -259,6 +896,11 @@ private:
     treap_left.swap(other.treap_left);
     treap_right.swap(other.treap_right);
     std::swap(size_, other.size_);
+    std::swap(alloc_, other.alloc_);
+    std::swap(rng_.state, other.rng_.state);
+    std::swap(hash_left_, other.hash_left_);
+    std::swap(hash_right_, other.hash_right_);
+    std::swap(counters_, other.counters_);
     validate_ends();
     other.validate_ends();
   }
@@ -288,6 +930,19 @@ public:
     return at<tag_right>(key);
   }
 
+  // Гетерогенные at (см. find_left выше)
+  template <typename K, typename C = CompareLeft,
+            typename = typename C::is_transparent>
+  right_t const &at_left(K const &key) const {
+    return at<tag_left>(key);
+  }
+
+  template <typename K, typename C = CompareRight,
+            typename = typename C::is_transparent>
+  left_t const &at_right(K const &key) const {
+    return at<tag_right>(key);
+  }
+
   // Возвращает противоположный элемент по элементу
   // Если элемента не существует, добавляет его в bimap и на противоположную
   // сторону кладет дефолтный элемент, ссылку на который и возвращает
@@ -305,11 +960,60 @@ public:
     return at_or_default<tag_right>(key);
   }
 
+  // Возвращает итератор на k-й (нумерация с нуля) по порядку left/right.
+  // Если k >= size(), возвращается соответствующий end().
+  left_iterator nth_left(std::size_t k) const {
+    return left_iterator(treap_left.nth(k));
+  }
+
+  right_iterator nth_right(std::size_t k) const {
+    return right_iterator(treap_right.nth(k));
+  }
+
+  // Возвращает количество пар с left (right) строго меньше данного.
+  std::size_t rank_left(left_t const &left) const {
+    return treap_left.rank(left, &key_getter<tag_left>);
+  }
+
+  std::size_t rank_right(right_t const &right) const {
+    return treap_right.rank(right, &key_getter<tag_right>);
+  }
+
+  // Гетерогенные rank (см. find_left выше)
+  template <typename K, typename C = CompareLeft,
+            typename = typename C::is_transparent>
+  std::size_t rank_left(K const &key) const {
+    return treap_left.rank(key, &key_getter<tag_left>);
+  }
+
+  template <typename K, typename C = CompareRight,
+            typename = typename C::is_transparent>
+  std::size_t rank_right(K const &key) const {
+    return treap_right.rank(key, &key_getter<tag_right>);
+  }
+
+  // Расстояние между итераторами одной стороны за O(log n).
+  std::ptrdiff_t distance_left(left_iterator first, left_iterator last) const {
+    return static_cast<std::ptrdiff_t>(treap_left.order_of(last.node)) -
+           static_cast<std::ptrdiff_t>(treap_left.order_of(first.node));
+  }
+
+  std::ptrdiff_t distance_right(right_iterator first,
+                                right_iterator last) const {
+    return static_cast<std::ptrdiff_t>(treap_right.order_of(last.node)) -
+           static_cast<std::ptrdiff_t>(treap_right.order_of(first.node));
+  }
+
   // lower и upper bound'ы по каждой стороне
   // Возвращают итераторы на соответствующие элементы
   // Смотри std::lower_bound, std::upper_bound.
   left_iterator lower_bound_left(const left_t &left) const {
-    return left_iterator(treap_left.lower_bound(left, &key_getter<tag_left>));
+    if constexpr (Policy::finger_search) {
+      return left_iterator(
+          treap_left.lower_bound_finger(left, &key_getter<tag_left>));
+    } else {
+      return left_iterator(treap_left.lower_bound(left, &key_getter<tag_left>));
+    }
   };
 
   left_iterator upper_bound_left(const left_t &left) const {
@@ -317,8 +1021,13 @@ public:
   }
 
   right_iterator lower_bound_right(const right_t &right) const {
-    return right_iterator(
-        treap_right.lower_bound(right, &key_getter<tag_right>));
+    if constexpr (Policy::finger_search) {
+      return right_iterator(
+          treap_right.lower_bound_finger(right, &key_getter<tag_right>));
+    } else {
+      return right_iterator(
+          treap_right.lower_bound(right, &key_getter<tag_right>));
+    }
   }
 
   right_iterator upper_bound_right(const right_t &right) const {
@@ -326,6 +1035,90 @@ public:
         treap_right.upper_bound(right, &key_getter<tag_right>));
   }
 
+  // Возвращает пару итераторов, ограничивающую все пары с ключом в [lo, hi):
+  // эквивалент {lower_bound(lo), lower_bound(hi)}, но общий префикс двух
+  // спусков проходится один раз.
+  std::pair<left_iterator, left_iterator>
+  equal_range_left(left_t const &lo, left_t const &hi) const {
+    auto res = treap_left.equal_range(lo, hi, &key_getter<tag_left>);
+    return std::pair(left_iterator(res.first), left_iterator(res.second));
+  }
+
+  std::pair<right_iterator, right_iterator>
+  equal_range_right(right_t const &lo, right_t const &hi) const {
+    auto res = treap_right.equal_range(lo, hi, &key_getter<tag_right>);
+    return std::pair(right_iterator(res.first), right_iterator(res.second));
+  }
+
+  // Количество пар с ключом в [lo, hi) за O(log n) по размерам поддеревьев,
+  // без обхода элементов.
+  std::size_t count_range_left(left_t const &lo, left_t const &hi) const {
+    return treap_left.count_range(lo, hi, &key_getter<tag_left>);
+  }
+
+  std::size_t count_range_right(right_t const &lo, right_t const &hi) const {
+    return treap_right.count_range(lo, hi, &key_getter<tag_right>);
+  }
+
+  // Пары с left в [lo, hi), упорядоченные по right: O(log n + k log k) для k
+  // подходящих пар. Диапазон выделяется одним equal_range-спуском (дерево не
+  // меняется, в отличие от split), узлы собираются по прошитому списку и
+  // сортируются правым компаратором — полный обход правой стороны с
+  // обратным поиском стоил бы O(n log n) независимо от k.
+  std::vector<right_iterator>
+  ordered_right_within_left_range(left_t const &lo, left_t const &hi) const {
+    auto range = treap_left.equal_range(lo, hi, &key_getter<tag_left>);
+    std::vector<right_iterator> res;
+    for (node_left *cur = range.first; cur != range.second; cur = cur->succ) {
+      res.push_back(right_iterator(
+          static_cast<node_right *>(static_cast<node_t *>(cur))));
+    }
+    std::sort(res.begin(), res.end(),
+              [this](right_iterator a, right_iterator b) {
+                return treap_right.less(*a, *b);
+              });
+    return res;
+  }
+
+  std::vector<left_iterator>
+  ordered_left_within_right_range(right_t const &lo, right_t const &hi) const {
+    auto range = treap_right.equal_range(lo, hi, &key_getter<tag_right>);
+    std::vector<left_iterator> res;
+    for (node_right *cur = range.first; cur != range.second; cur = cur->succ) {
+      res.push_back(left_iterator(
+          static_cast<node_left *>(static_cast<node_t *>(cur))));
+    }
+    std::sort(res.begin(), res.end(), [this](left_iterator a, left_iterator b) {
+      return treap_left.less(*a, *b);
+    });
+    return res;
+  }
+
+  // Гетерогенные bound'ы (см. find_left выше)
+  template <typename K, typename C = CompareLeft,
+            typename = typename C::is_transparent>
+  left_iterator lower_bound_left(K const &key) const {
+    return left_iterator(treap_left.lower_bound(key, &key_getter<tag_left>));
+  }
+
+  template <typename K, typename C = CompareLeft,
+            typename = typename C::is_transparent>
+  left_iterator upper_bound_left(K const &key) const {
+    return left_iterator(treap_left.upper_bound(key, &key_getter<tag_left>));
+  }
+
+  template <typename K, typename C = CompareRight,
+            typename = typename C::is_transparent>
+  right_iterator lower_bound_right(K const &key) const {
+    return right_iterator(treap_right.lower_bound(key, &key_getter<tag_right>));
+  }
+
+  template <typename K, typename C = CompareRight,
+            typename = typename C::is_transparent>
+  right_iterator upper_bound_right(K const &key) const {
+    return right_iterator(treap_right.upper_bound(key, &key_getter<tag_right>));
+  }
+
   // Возващает итератор на минимальный по порядку left.
   left_iterator begin_left() const noexcept {
     return left_iterator(treap_left.first());
@@ -350,6 +1143,143 @@ public:
   // Возвращает размер бимапы (кол-во пар)
   [[nodiscard]] std::size_t size() const { return size_; }
 
+  // Снимок счетчиков операций (только с политикой with_stats). Счетчики
+  // сравнений живут в компараторах деревьев и при swap/move переезжают
+  // вместе с содержимым.
+  template <bool S = Policy::stats, typename = std::enable_if_t<S>>
+  bimap_stats stats() const {
+    bimap_stats res;
+    res.finds = counters_.finds;
+    res.inserts = counters_.inserts;
+    res.erases = counters_.erases;
+    res.allocations = counters_.allocations;
+    res.deallocations = counters_.deallocations;
+    res.comparisons_left =
+        static_cast<compare_t<tag_left> const &>(treap_left.storage).count;
+    res.comparisons_right =
+        static_cast<compare_t<tag_right> const &>(treap_right.storage).count;
+    res.live_nodes = size_;
+    return res;
+  }
+
+  // Распределение глубин узлов дерева: гистограмма, максимум и среднее.
+  // Обход за O(n log n) — для периодического скрейпа метрик, не для горячего
+  // пути. Доступно при любой политике: состояние не накапливается.
+  bimap_depth_stats depth_stats_left() const {
+    return depth_stats<tag_left>();
+  }
+
+  bimap_depth_stats depth_stats_right() const {
+    return depth_stats<tag_right>();
+  }
+
+  // Сохраняет bimap в бинарный снапшот: ключи и приоритеты в порядке left,
+  // затем right-перестановка. Доступно только для тривиально копируемых
+  // ключей. Возвращает false при ошибке ввода-вывода.
+  template <typename L = left_t, typename R = right_t,
+            typename = std::enable_if_t<std::is_trivially_copyable_v<L> &&
+                                        std::is_trivially_copyable_v<R>>>
+  bool save(char const *path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    write_raw(out, snapshot_magic);
+    write_raw(out, static_cast<std::uint64_t>(size_));
+    for (left_iterator it = begin_left(); it != end_left(); ++it) {
+      write_raw(out, *it);
+      write_raw(out, *it.flip());
+      write_raw(out, it.node->priority);
+      write_raw(out, it.flip().node->priority);
+    }
+    for (right_iterator it = begin_right(); it != end_right(); ++it) {
+      auto *src = static_cast<node_t *>(it.node);
+      write_raw(out, static_cast<std::uint32_t>(
+                         treap_left.order_of(static_cast<node_left *>(src))));
+    }
+    return bool(out);
+  }
+
+  // Загружает снапшот, заменяя текущее содержимое. Деревья воссоздаются
+  // линейным построением по сохраненному порядку и приоритетам — без
+  // сравнений ключей и за один проход, так что старт упирается в чтение
+  // файла, а не в построение дерева. При ошибке (включая битый файл) bimap
+  // не изменяется и возвращается false.
+  template <typename L = left_t, typename R = right_t,
+            typename = std::enable_if_t<std::is_trivially_copyable_v<L> &&
+                                        std::is_trivially_copyable_v<R>>>
+  bool load(char const *path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      return false;
+    }
+    std::uint32_t magic = 0;
+    std::uint64_t count = 0;
+    if (!read_raw(in, magic) || magic != snapshot_magic ||
+        !read_raw(in, count)) {
+      return false;
+    }
+    std::vector<node_t *> by_left;
+    std::vector<node_right *> by_right;
+    by_left.reserve(count);
+    bool ok = true;
+    try {
+      for (std::uint64_t i = 0; ok && i < count; i++) {
+        left_t l;
+        right_t r;
+        int prio_l, prio_r;
+        ok = read_raw(in, l) && read_raw(in, r) && read_raw(in, prio_l) &&
+             read_raw(in, prio_r);
+        // the nodes were written in left order; anything non-ascending would
+        // hand assign_ordered a tree that violates the search invariant
+        if (ok && !by_left.empty() &&
+            !treap_left.less(by_left.back()->key_left, l)) {
+          ok = false;
+        }
+        if (ok) {
+          node_t *node = make_node(std::move(l), std::move(r));
+          static_cast<node_left *>(node)->priority = prio_l;
+          static_cast<node_right *>(node)->priority = prio_r;
+          by_left.push_back(node);
+        }
+      }
+      by_right.resize(count, nullptr);
+      // the index block must be a permutation that walks the right keys in
+      // ascending order: a repeated index would alias one node from several
+      // right-tree positions, an out-of-order one would break the invariant
+      std::vector<char> seen(count, 0);
+      for (std::uint64_t i = 0; ok && i < count; i++) {
+        std::uint32_t idx = 0;
+        ok = read_raw(in, idx) && idx < count && !seen[idx] &&
+             (i == 0 || treap_right.less(
+                            static_cast<node_t *>(by_right[i - 1])->key_right,
+                            by_left[idx]->key_right));
+        if (ok) {
+          seen[idx] = 1;
+          by_right[i] = static_cast<node_right *>(by_left[idx]);
+        }
+      }
+    } catch (...) {
+      ok = false;
+    }
+    if (!ok) {
+      for (node_t *node : by_left) {
+        destroy_node(node);
+      }
+      return false;
+    }
+    // the loaded nodes came from alloc_, so the bulk release_all teardown of
+    // erase_all would free them too; drain the old contents node by node
+    erase_left(begin_left(), end_left());
+    treap_left.assign_ordered(by_left.begin(), by_left.end());
+    treap_right.assign_ordered(by_right.begin(), by_right.end());
+    for (node_t *node : by_left) {
+      index_insert(node);
+    }
+    size_ = by_left.size();
+    return true;
+  }
+
   // операторы сравнения
   template <typename TL, typename TR, typename CompL, typename CompR>
   friend bool operator==(bimap const &a, bimap const &b);
@@ -366,8 +1296,16 @@ private:
     }
   }
 
-  template <typename Tag>
-  key_t_other<Tag> const &at(const key_t<Tag> &key) const {
+  template <typename Tag, typename K>
+  key_t_other<Tag> const &at(const K &key) const {
+    if constexpr (Policy::hash_index && std::is_same_v<K, key_t<Tag>>) {
+      node_t *node = get_index<Tag>().find(key);
+      if (node == nullptr) {
+        throw std::out_of_range("Key not found");
+      }
+      return key_getter<tag_other<Tag>>(
+          static_cast<node_other<Tag> *>(static_cast<node_t_base *>(node)));
+    }
     const treap_t<Tag> *treap_;
     if constexpr (std::is_same_v<Tag, tag_left>) {
       treap_ = &treap_left;
@@ -384,38 +1322,243 @@ private:
 
   template <typename Tag>
   key_t_other<Tag> const &at_or_default(const key_t<Tag> &key) {
-    if (contains<Tag>(key)) {
-      return at<Tag>(key);
+    auto pos = get_treap<Tag>().find_insert_pos(key, &key_getter<Tag>);
+    if (pos.found != nullptr) {
+      // found-path: a single descent of this side's tree
+      return key_getter<tag_other<Tag>>(
+          static_cast<node_other<Tag> *>(static_cast<node_t *>(pos.found)));
     }
     key_t_other<Tag> val = key_t_other<Tag>();
-    iterator<tag_other<Tag>> it = find<tag_other<Tag>>(val);
-    if (it != end<tag_other<Tag>>()) {
-      erase_impl<tag_other<Tag>>(it);
+    auto pos_o = get_treap<tag_other<Tag>>().find_insert_pos(
+        val, &key_getter<tag_other<Tag>>);
+    if (pos_o.found != nullptr) {
+      // the default value is already paired: re-key that node in place
+      // instead of destroying and reinserting the pair; only this side's
+      // tree changes, and the removal forces one fresh probe of it
+      auto *node = static_cast<node_t *>(pos_o.found);
+      get_treap<Tag>().remove(static_cast<node_<Tag> *>(node));
+      if constexpr (Policy::hash_index) {
+        get_index<Tag>().erase(key_getter<Tag>(static_cast<node_<Tag> *>(node)));
+      }
+      key_getter<Tag>(static_cast<node_<Tag> *>(node)) = key;
+      auto fresh = get_treap<Tag>().find_insert_pos(key, &key_getter<Tag>);
+      get_treap<Tag>().insert_at(fresh, static_cast<node_<Tag> *>(node));
+      if constexpr (Policy::hash_index) {
+        get_index<Tag>().insert(node);
+      }
+      return key_getter<tag_other<Tag>>(static_cast<node_other<Tag> *>(node));
     }
+    // both probes missed: insert at the captured slots, one descent per tree
+    node_t *node;
     if constexpr (is_left<Tag>) {
-      return *insert(key, val).flip();
+      node = make_node(key, std::move(val));
     } else {
-      return *insert(val, key);
+      node = make_node(std::move(val), key);
     }
+    get_treap<Tag>().insert_at(pos, static_cast<node_<Tag> *>(node));
+    get_treap<tag_other<Tag>>().insert_at(
+        pos_o, static_cast<node_other<Tag> *>(node));
+    index_insert(node);
+    stat_insert();
+    ++size_;
+    return key_getter<tag_other<Tag>>(static_cast<node_other<Tag> *>(node));
   }
 
-  void erase_all() { erase_left(begin_left(), end_left()); }
+  struct batch_order {
+    std::vector<std::size_t> by_right; // indices of items in right-key order
+    std::vector<char> removed;         // entries to drop
+  };
 
-  void insert_all(const bimap &other) {
-    for (left_iterator iter = other.begin_left(); iter != other.end_left();
-         ++iter) {
-      insert(*iter, *iter.flip());
+  // sorts items by left key (only if needed) and marks duplicates on either
+  // side; of colliding pairs the one with the smaller left key survives
+  batch_order dedup_batch(std::vector<std::pair<left_t, right_t>> &items) {
+    auto left_less = [this](auto const &a, auto const &b) {
+      return treap_left.less(a.first, b.first);
+    };
+    if (!std::is_sorted(items.begin(), items.end(), left_less)) {
+      // stable, so of pairs with equal left the earlier one in the input wins
+      std::stable_sort(items.begin(), items.end(), left_less);
+    }
+    auto left_eq = [this](auto const &a, auto const &b) {
+      return !treap_left.less(a.first, b.first) &&
+             !treap_left.less(b.first, a.first);
+    };
+    items.erase(std::unique(items.begin(), items.end(), left_eq), items.end());
+
+    // order by right key; stable sort keeps left order inside runs of equal
+    // rights, so dropping all but the first of a run keeps the smaller left
+    batch_order order;
+    order.by_right.resize(items.size());
+    std::iota(order.by_right.begin(), order.by_right.end(), std::size_t(0));
+    auto right_less = [this, &items](std::size_t a, std::size_t b) {
+      return treap_right.less(items[a].second, items[b].second);
+    };
+    if (!std::is_sorted(order.by_right.begin(), order.by_right.end(),
+                        right_less)) {
+      std::stable_sort(order.by_right.begin(), order.by_right.end(),
+                       right_less);
+    }
+    order.removed.assign(items.size(), 0);
+    if (!order.by_right.empty()) {
+      std::size_t run_first = order.by_right[0];
+      for (std::size_t i = 1; i < order.by_right.size(); i++) {
+        if (right_less(run_first, order.by_right[i])) {
+          run_first = order.by_right[i];
+        } else {
+          order.removed[order.by_right[i]] = 1;
+        }
+      }
     }
+    return order;
+  }
+
+  // allocates nodes for the surviving entries (moving the keys out of items)
+  // and fills left- and right-ordered pointer vectors; frees everything
+  // already allocated if a key constructor throws
+  void build_batch_nodes(std::vector<std::pair<left_t, right_t>> &items,
+                         batch_order const &order,
+                         std::vector<node_t *> &by_left_nodes,
+                         std::vector<node_right *> &by_right_nodes) {
+    std::vector<node_t *> node_of(items.size(), nullptr);
+    by_left_nodes.reserve(items.size());
+    try {
+      for (std::size_t i = 0; i < items.size(); i++) {
+        if (order.removed[i]) {
+          continue;
+        }
+        node_t *node =
+            make_node(std::move(items[i].first), std::move(items[i].second));
+        node_of[i] = node;
+        by_left_nodes.push_back(node);
+      }
+    } catch (...) {
+      for (node_t *node : by_left_nodes) {
+        destroy_node(node);
+      }
+      throw;
+    }
+    by_right_nodes.reserve(by_left_nodes.size());
+    for (std::size_t i : order.by_right) {
+      if (node_of[i] != nullptr) {
+        by_right_nodes.push_back(static_cast<node_right *>(node_of[i]));
+      }
+    }
+  }
+
+  static constexpr std::uint32_t snapshot_magic = 0x70616d62; // "bmap"
+
+  template <typename V> static void write_raw(std::ostream &out, V const &v) {
+    out.write(reinterpret_cast<char const *>(&v), sizeof(V));
+  }
+
+  template <typename V> static bool read_raw(std::istream &in, V &v) {
+    return bool(in.read(reinterpret_cast<char *>(&v), sizeof(V)));
+  }
+
+  template <typename... Args> node_t *make_node(Args &&...args) {
+    node_t *node = node_alloc_traits::allocate(alloc_, 1);
+    try {
+      node_alloc_traits::construct(alloc_, node, std::forward<Args>(args)...);
+    } catch (...) {
+      node_alloc_traits::deallocate(alloc_, node, 1);
+      throw;
+    }
+    auto prio = rng_.next_pair();
+    static_cast<node_left *>(node)->priority = prio.first;
+    static_cast<node_right *>(node)->priority = prio.second;
+    stat_alloc();
+    return node;
+  }
+
+  void destroy_node(node_t *node) {
+    node_alloc_traits::destroy(alloc_, node);
+    node_alloc_traits::deallocate(alloc_, node, 1);
+    stat_dealloc();
+  }
+
+  void erase_all() {
+    if constexpr (has_release_all<node_allocator>::value &&
+                  std::is_trivially_destructible_v<node_t>) {
+      // bulk teardown: drop whole pool chunks instead of N node frees
+      treap_left.last()->left = nullptr;
+      treap_right.last()->left = nullptr;
+      treap_left.last()->succ = treap_left.last()->pred = treap_left.last();
+      treap_right.last()->succ = treap_right.last()->pred = treap_right.last();
+      treap_left.storage.finger = nullptr;
+      treap_right.storage.finger = nullptr;
+      index_clear();
+      size_ = 0;
+      alloc_.release_all();
+    } else {
+      erase_left(begin_left(), end_left());
+    }
+  }
+
+  // structural clone: nodes are copied in left order with the source
+  // priorities, then both trees are rebuilt with the linear sorted builder.
+  // Same (order, priority) pairs give the copy the source's shape, and not a
+  // single key comparison is made; the old per-pair reinsertion cost
+  // O(n log n) comparisons on top of the allocations
+  void clone_from(const bimap &other) {
+    std::vector<node_t *> by_left;
+    by_left.reserve(other.size_);
+    try {
+      for (left_iterator it = other.begin_left(); it != other.end_left();
+           ++it) {
+        node_t *node = make_node(*it, *it.flip());
+        static_cast<node_left *>(node)->priority = it.node->priority;
+        static_cast<node_right *>(node)->priority = it.flip().node->priority;
+        by_left.push_back(node);
+      }
+    } catch (...) {
+      for (node_t *node : by_left) {
+        destroy_node(node);
+      }
+      throw;
+    }
+    // the clone of a source node is found by the source's left-order index,
+    // which order_of computes by climbing parents — again comparison-free
+    std::vector<node_right *> by_right;
+    by_right.reserve(by_left.size());
+    for (right_iterator it = other.begin_right(); it != other.end_right();
+         ++it) {
+      auto *src = static_cast<node_t *>(it.node);
+      by_right.push_back(static_cast<node_right *>(
+          by_left[other.treap_left.order_of(static_cast<node_left *>(src))]));
+    }
+    treap_left.assign_ordered(by_left.begin(), by_left.end());
+    treap_right.assign_ordered(by_right.begin(), by_right.end());
+    for (node_t *node : by_left) {
+      index_insert(node);
+    }
+    size_ = by_left.size();
+  }
+
+  node_handle extract(node_t *node) {
+    treap_right.remove(static_cast<node_right *>(node));
+    treap_left.remove(static_cast<node_left *>(node));
+    index_erase(node);
+    --size_;
+    return node_handle(this, node);
   }
 
   template <typename T1, typename T2>
   left_iterator insert_impl(T1 &&left, T2 &&right) {
-    if (contains<tag_left>(left) || contains<tag_right>(right)) {
+    // single descent per side: the uniqueness probe captures the leaf slot,
+    // which insert_at then reuses without descending again
+    auto pos_l = treap_left.find_insert_pos(left, &key_getter<tag_left>);
+    if (pos_l.found != nullptr) {
+      return end_left();
+    }
+    auto pos_r = treap_right.find_insert_pos(right, &key_getter<tag_right>);
+    if (pos_r.found != nullptr) {
       return end_left();
     }
-    auto *node = new node_t(std::forward<T1>(left), std::forward<T2>(right));
-    treap_left.insert(node, &key_getter<tag_left>);
-    treap_right.insert(node, &key_getter<tag_right>);
+    auto *node = make_node(std::forward<T1>(left), std::forward<T2>(right));
+    treap_left.insert_at(pos_l, node);
+    treap_right.insert_at(pos_r, node);
+    index_insert(node);
+    stat_insert();
     ++size_;
     return left_iterator(node);
   }
@@ -424,7 +1567,9 @@ private:
     auto *ptr = static_cast<node_t *>(iter.node);
     auto *res_r = treap_right.remove(static_cast<node_right *>(ptr));
     auto *res_l = treap_left.remove(static_cast<node_left *>(ptr));
-    delete ptr;
+    index_erase(ptr);
+    destroy_node(ptr);
+    stat_erase();
     --size_;
     if constexpr (is_left<Tag>) {
       return iterator<Tag>(static_cast<node_<Tag> *>(res_l));
@@ -435,22 +1580,171 @@ private:
 
   template <typename Tag>
   bool erase_impl(const key_t<Tag> &key, treap_t<Tag> &tree) {
-    auto *node = tree.find(key, &key_getter<Tag>);
-    if (tree.is_last(node)) {
+    // the caller discards any position, so the fused single-descent removal
+    // applies: no find-then-erase double traversal, no successor handling
+    auto *node = tree.remove_key(key, &key_getter<Tag>);
+    if (node == nullptr) {
       return false;
     }
-    erase_impl<Tag>(iterator<Tag>(node));
+    auto *ptr = static_cast<node_t *>(node);
+    get_treap<tag_other<Tag>>().remove(static_cast<node_other<Tag> *>(ptr));
+    index_erase(ptr);
+    destroy_node(ptr);
+    stat_erase();
+    --size_;
     return true;
   }
 
   template <typename Tag>
   iterator<Tag> erase_impl(iterator<Tag> first, iterator<Tag> last) {
-    while (first != last) {
-      first = erase_impl<Tag>(first);
+    if (first == last) {
+      return last;
+    }
+    // the whole range is cut out of this side's tree in O(log n); only the
+    // paired keys, which are scattered, need per-node removal on the other
+    node_<Tag> *range;
+    if (last == end<Tag>()) {
+      range = get_treap<Tag>().extract_lower(*first, &key_getter<Tag>);
+    } else {
+      range = get_treap<Tag>().extract_range(*first, *last, &key_getter<Tag>);
     }
+    dispose_range<Tag>(range);
     return last;
   }
 
+  // removes every node of a detached subtree from the other side's tree and
+  // frees it; works leaves-up so no node is touched after its children
+  template <typename Tag> void dispose_range(node_<Tag> *node) {
+    while (node != nullptr) {
+      if (node->left != nullptr) {
+        node = node->left;
+        continue;
+      }
+      if (node->right != nullptr) {
+        node = node->right;
+        continue;
+      }
+      node_<Tag> *par = node->parent;
+      if (par != nullptr) {
+        (par->left == node ? par->left : par->right) = nullptr;
+      }
+      auto *ptr = static_cast<node_t *>(node);
+      get_treap<tag_other<Tag>>().remove(
+          static_cast<node_other<Tag> *>(ptr));
+      index_erase(ptr);
+      destroy_node(ptr);
+      stat_erase();
+      --size_;
+      node = par;
+    }
+  }
+
+  template <typename Tag> treap_t<Tag> &get_treap() {
+    if constexpr (is_left<Tag>) {
+      return treap_left;
+    } else {
+      return treap_right;
+    }
+  }
+
+  template <typename Tag> auto &get_index() {
+    if constexpr (is_left<Tag>) {
+      return hash_left_;
+    } else {
+      return hash_right_;
+    }
+  }
+
+  template <typename Tag> auto const &get_index() const {
+    if constexpr (is_left<Tag>) {
+      return hash_left_;
+    } else {
+      return hash_right_;
+    }
+  }
+
+  // the stat hooks, like the index hooks below, compile away when disabled
+  void stat_find() const {
+    if constexpr (Policy::stats) {
+      ++counters_.finds;
+    }
+  }
+
+  void stat_insert(std::size_t n = 1) {
+    if constexpr (Policy::stats) {
+      counters_.inserts += n;
+    }
+  }
+
+  void stat_erase() {
+    if constexpr (Policy::stats) {
+      ++counters_.erases;
+    }
+  }
+
+  void stat_alloc() {
+    if constexpr (Policy::stats) {
+      ++counters_.allocations;
+    }
+  }
+
+  void stat_dealloc() {
+    if constexpr (Policy::stats) {
+      ++counters_.deallocations;
+    }
+  }
+
+  template <typename Tag> bimap_depth_stats depth_stats() const {
+    bimap_depth_stats res;
+    const treap_t<Tag> *tree;
+    if constexpr (is_left<Tag>) {
+      tree = &treap_left;
+    } else {
+      tree = &treap_right;
+    }
+    std::uint64_t total = 0;
+    for (const node_<Tag> *node = tree->first(); !tree->is_last(node);
+         node = node->succ) {
+      std::size_t d = 0;
+      for (const node_<Tag> *cur = node; !tree->is_last(cur->parent);
+           cur = cur->parent) {
+        ++d;
+      }
+      if (d >= res.histogram.size()) {
+        res.histogram.resize(d + 1, 0);
+      }
+      ++res.histogram[d];
+      res.max_depth = std::max(res.max_depth, d);
+      total += d;
+    }
+    if (size_ != 0) {
+      res.avg_depth = static_cast<double>(total) / static_cast<double>(size_);
+    }
+    return res;
+  }
+
+  // the three index hooks compile away entirely for the default policy
+  void index_insert(node_t *node) {
+    if constexpr (Policy::hash_index) {
+      hash_left_.insert(node);
+      hash_right_.insert(node);
+    }
+  }
+
+  void index_erase(node_t *node) {
+    if constexpr (Policy::hash_index) {
+      hash_left_.erase(node->key_left);
+      hash_right_.erase(node->key_right);
+    }
+  }
+
+  void index_clear() {
+    if constexpr (Policy::hash_index) {
+      hash_left_.clear();
+      hash_right_.clear();
+    }
+  }
+
   void validate_ends() noexcept {
     validate_end(static_cast<node_left *>(&end_node), treap_left);
     validate_end(static_cast<node_right *>(&end_node), treap_right);
@@ -461,19 +1755,48 @@ private:
     base->parent = nullptr;
     base->right = nullptr;
     base->left = tree.root();
+    // end_node is constructed after the treaps, so its default-initialized
+    // priority has to be bumped back to the sentinel value insert_at relies on
+    base->priority = std::numeric_limits<int>::max();
     tree.storage.end_elem = base;
     tree.set_parent(base->left, base);
+    // re-splice the successor list around this end node: after a swap the
+    // inner links are intact but both extremes still point at the old end
+    base->succ = base;
+    base->pred = base;
+    if (base->left != nullptr) {
+      node_<Tag> *lo = base->left;
+      while (lo->left != nullptr) {
+        lo = lo->left;
+      }
+      node_<Tag> *hi = base->left;
+      while (hi->right != nullptr) {
+        hi = hi->right;
+      }
+      base->succ = lo;
+      lo->pred = base;
+      base->pred = hi;
+      hi->succ = base;
+    }
   }
 
-  treap<left_t, CompareLeft, tag_left> treap_left;
-  treap<right_t, CompareRight, tag_right> treap_right;
+  treap_t<tag_left> treap_left;
+  treap_t<tag_right> treap_right;
   size_t size_ = 0;
   node_t_base end_node;
+  node_allocator alloc_;
+  priority_source rng_;
+  std::conditional_t<Policy::hash_index, hash_index_t<tag_left>, no_index>
+      hash_left_;
+  std::conditional_t<Policy::hash_index, hash_index_t<tag_right>, no_index>
+      hash_right_;
+  std::conditional_t<Policy::stats, op_counters, no_stats> counters_;
 };
 
-template <typename TL, typename TR, typename CompL, typename CompR>
-bool operator==(const bimap<TL, TR, CompL, CompR> &map1,
-                const bimap<TL, TR, CompL, CompR> &map2) {
+template <typename TL, typename TR, typename CompL, typename CompR,
+          typename Alloc, typename Policy>
+bool operator==(const bimap<TL, TR, CompL, CompR, Alloc, Policy> &map1,
+                const bimap<TL, TR, CompL, CompR, Alloc, Policy> &map2) {
   if (map1.size() != map2.size()) {
     return false;
   }
@@ -489,8 +1812,16 @@ bool operator==(const bimap<TL, TR, CompL, CompR> &map1,
   return true;
 }
 
-template <typename TL, typename TR, typename CompL, typename CompR>
-bool operator!=(const bimap<TL, TR, CompL, CompR> &map1,
-                const bimap<TL, TR, CompL, CompR> &map2) {
+template <typename TL, typename TR, typename CompL, typename CompR,
+          typename Alloc, typename Policy>
+bimap_diff<TL, TR> diff(const bimap<TL, TR, CompL, CompR, Alloc, Policy> &from,
+                        const bimap<TL, TR, CompL, CompR, Alloc, Policy> &to) {
+  return from.diff_to(to);
+}
+
+template <typename TL, typename TR, typename CompL, typename CompR,
+          typename Alloc, typename Policy>
+bool operator!=(const bimap<TL, TR, CompL, CompR, Alloc, Policy> &map1,
+                const bimap<TL, TR, CompL, CompR, Alloc, Policy> &map2) {
   return !(map1 == map2);
 }
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Streaming ingestion front for bimap.
+//
+// Network threads enqueue insert/erase operations onto a lock-free MPSC
+// list (one CAS per push, producers never block or allocate under a lock);
+// a single consumer drains everything with apply_pending(), which turns
+// runs of consecutive inserts into one bulk batch insert — the
+// O(m log(n/m)) unite path — and applies erases at their arrival points,
+// so the queue order is honored exactly. Bursts cost the consumer one
+// batched apply instead of a long exclusive-lock convoy of single inserts.
+//
+// Concurrency contract: any number of producers may enqueue concurrently;
+// apply_pending() and map() reads are consumer-side and must not overlap
+// each other or run during an apply. Staleness is bounded by how often the
+// consumer drains.
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>>
+struct bimap_ingest {
+  using left_t = Left;
+  using right_t = Right;
+  using map_t = bimap<Left, Right, CompareLeft, CompareRight>;
+
+  explicit bimap_ingest(CompareLeft compare_left = CompareLeft(),
+                        CompareRight compare_right = CompareRight())
+      : cmp_right_(compare_right),
+        map_(std::move(compare_left), std::move(compare_right)) {}
+
+  bimap_ingest(bimap_ingest const &) = delete;
+  bimap_ingest &operator=(bimap_ingest const &) = delete;
+
+  ~bimap_ingest() {
+    op_node *node = head_.exchange(nullptr, std::memory_order_acquire);
+    while (node != nullptr) {
+      op_node *next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  // producer side: wait-free except for the allocation, never takes a lock
+  void enqueue_insert(left_t left, right_t right) {
+    push(new op_node(op_kind::insert, std::move(left), std::move(right)));
+  }
+
+  void enqueue_erase_left(left_t left) {
+    push(new op_node(op_kind::erase_left, std::move(left), std::nullopt));
+  }
+
+  void enqueue_erase_right(right_t right) {
+    push(new op_node(op_kind::erase_right, std::nullopt, std::move(right)));
+  }
+
+  // consumer side: drains the queue and applies it in arrival order,
+  // batching insert runs through the bulk path. Returns the number of
+  // operations applied
+  std::size_t apply_pending() {
+    // the list comes out newest-first; reverse it into arrival order
+    op_node *node = head_.exchange(nullptr, std::memory_order_acquire);
+    op_node *ordered = nullptr;
+    while (node != nullptr) {
+      op_node *next = node->next;
+      node->next = ordered;
+      ordered = node;
+      node = next;
+    }
+    std::size_t applied = 0;
+    std::vector<std::pair<left_t, right_t>> batch;
+    // a batch keeps the earliest entry of a duplicate left key, which is
+    // exactly what sequential insertion of the run would do; a duplicate
+    // RIGHT key would be resolved by smallest left instead of arrival
+    // order, so it forces a flush first — as erases do — and the earlier
+    // pair wins like it would sequentially
+    std::set<right_t, CompareRight> batch_rights(cmp_right_);
+    auto flush = [this, &batch, &batch_rights] {
+      if (!batch.empty()) {
+        map_.insert(std::move(batch));
+        batch.clear();
+        batch_rights.clear();
+      }
+    };
+    while (ordered != nullptr) {
+      op_node *next = ordered->next;
+      switch (ordered->kind) {
+      case op_kind::insert:
+        if (!batch_rights.insert(*ordered->right).second) {
+          flush();
+          batch_rights.insert(*ordered->right);
+        }
+        batch.emplace_back(std::move(*ordered->left),
+                           std::move(*ordered->right));
+        break;
+      case op_kind::erase_left:
+        flush();
+        map_.erase_left(*ordered->left);
+        break;
+      case op_kind::erase_right:
+        flush();
+        map_.erase_right(*ordered->right);
+        break;
+      }
+      ++applied;
+      delete ordered;
+      ordered = next;
+    }
+    flush();
+    return applied;
+  }
+
+  // consumer-side view of the applied state
+  map_t const &map() const { return map_; }
+
+private:
+  enum class op_kind : unsigned char { insert, erase_left, erase_right };
+
+  struct op_node {
+    op_kind kind;
+    std::optional<left_t> left;
+    std::optional<right_t> right;
+    op_node *next = nullptr;
+
+    op_node(op_kind kind, std::optional<left_t> left,
+            std::optional<right_t> right)
+        : kind(kind), left(std::move(left)), right(std::move(right)) {}
+  };
+
+  void push(op_node *node) {
+    node->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(node->next, node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  std::atomic<op_node *> head_{nullptr};
+  CompareRight cmp_right_; // batch right-collision detection in apply_pending
+  map_t map_;
+};
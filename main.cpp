@@ -1,6 +1,13 @@
+#include <atomic>
 #include <random>
+#include <thread>
 
 #include "bimap.h"
+#include "ingest-queue.h"
+#include "node-pool.h"
+#include "parallel-for-each.h"
+#include "sharded-bimap.h"
+#include "small-bimap.h"
 #include "test-classes.h"
 #include "gtest/gtest.h"
 
@@ -13,6 +20,681 @@ TEST(bimap, leak_check) {
   }
 }
 
+TEST(bimap, pool_allocator_mode) {
+  using pooled_bimap = bimap<int, int, std::less<int>, std::less<int>,
+                             pool_allocator<std::pair<int, int>>>;
+  pooled_bimap b;
+
+  std::mt19937 e(std::random_device{}());
+  for (size_t i = 0; i < 10000; i++) {
+    b.insert(e() % 100000, e() % 100000);
+  }
+  size_t size = b.size();
+  // erased slots must be reused from the free list
+  while (b.size() > size / 2) {
+    b.erase_left(b.begin_left());
+  }
+  for (size_t i = 0; i < 10000; i++) {
+    b.insert(100000 + e() % 100000, 100000 + e() % 100000);
+  }
+  int prev = *b.begin_left();
+  for (auto it = ++b.begin_left(); it != b.end_left(); it++) {
+    EXPECT_LT(prev, *it);
+    prev = *it;
+  }
+}
+
+TEST(bimap, pool_allocator_assign) {
+  // assign builds the replacement nodes from the same pool before the old
+  // contents are torn down, so the bulk release path must not run
+  using pooled_bimap = bimap<int, int, std::less<int>, std::less<int>,
+                             pool_allocator<std::pair<int, int>>>;
+  std::vector<std::pair<int, int>> data;
+  for (int i = 0; i < 100; i++) {
+    data.emplace_back(i, i + 1000);
+  }
+  pooled_bimap b;
+  for (int i = 0; i < 500; i++) {
+    b.insert(i * 3, i * 3 + 5000);
+  }
+  b.assign(data.begin(), data.end());
+  EXPECT_EQ(b.size(), 100);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(b.at_left(i), i + 1000);
+  }
+  // the range constructor delegates to assign
+  pooled_bimap c(data.begin(), data.end());
+  EXPECT_EQ(c.size(), 100);
+  EXPECT_EQ(c.at_right(1042), 42);
+  // the map stays usable afterwards
+  b.insert(-1, -1);
+  b.erase_left(0);
+  EXPECT_EQ(b.size(), 100);
+}
+
+TEST(bimap, pool_allocator_merge_and_handles) {
+  // two pool-backed maps never compare equal (pools are identity-compared),
+  // so node exchange must fall back to copying instead of adopting nodes
+  using pooled_bimap = bimap<int, int, std::less<int>, std::less<int>,
+                             pool_allocator<std::pair<int, int>>>;
+  pooled_bimap a;
+  pooled_bimap b;
+  for (int i = 0; i < 100; i++) {
+    a.insert(i, i + 1000);
+  }
+  for (int i = 50; i < 150; i++) {
+    b.insert(i, i + 1000);
+  }
+  EXPECT_EQ(a.merge(b), 50);
+  EXPECT_EQ(a.size(), 150);
+  EXPECT_EQ(b.size(), 50); // the conflicting pairs stay behind
+  EXPECT_EQ(a.at_left(149), 1149);
+
+  auto nh = b.extract_left(b.begin_left());
+  ASSERT_FALSE(nh.empty());
+  nh.left() = 1000;
+  nh.right() = 2000;
+  EXPECT_NE(a.insert(std::move(nh)), a.end_left());
+  EXPECT_EQ(a.at_left(1000), 2000);
+  // both maps (and their pools) must tear down cleanly after the exchange
+}
+
+TEST(sharded_bimap, basic_semantics) {
+  sharded_bimap<int, int> m;
+  EXPECT_TRUE(m.insert(1, 100));
+  EXPECT_FALSE(m.insert(1, 200)); // duplicate left
+  EXPECT_FALSE(m.insert(2, 100)); // duplicate right, likely another shard
+  EXPECT_TRUE(m.insert(2, 200));
+  EXPECT_EQ(m.size(), 2);
+  EXPECT_EQ(m.find_left(1), std::optional<int>(100));
+  EXPECT_EQ(m.find_right(200), std::optional<int>(2));
+  EXPECT_FALSE(m.find_left(3).has_value());
+  EXPECT_TRUE(m.erase_right(100));
+  EXPECT_FALSE(m.erase_left(1));
+  EXPECT_EQ(m.size(), 1);
+  EXPECT_FALSE(m.empty());
+}
+
+TEST(sharded_bimap, concurrent_readers_and_writer) {
+  sharded_bimap<uint32_t, uint32_t> m;
+  for (uint32_t i = 0; i < 1000; i++) {
+    m.insert(i, i + 1000000);
+  }
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> hits{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&] {
+      std::mt19937 e(std::random_device{}());
+      while (!stop) {
+        if (m.find_left(e() % 2000).has_value()) {
+          hits++;
+        }
+      }
+    });
+  }
+  std::thread writer([&] {
+    for (uint32_t i = 1000; i < 2000; i++) {
+      m.insert(i, i + 1000000);
+    }
+    for (uint32_t i = 0; i < 500; i++) {
+      m.erase_left(i);
+    }
+  });
+  writer.join();
+  stop = true;
+  for (auto &r : readers) {
+    r.join();
+  }
+  EXPECT_EQ(m.size(), 1500);
+  EXPECT_GT(hits.load(), 0);
+}
+
+TEST(small_bimap, inline_and_promotion) {
+  small_bimap<int, std::string, std::less<int>, std::less<std::string>, 4> m;
+  EXPECT_TRUE(m.insert(3, "c"));
+  EXPECT_TRUE(m.insert(1, "a"));
+  EXPECT_TRUE(m.insert(2, "b"));
+  EXPECT_FALSE(m.insert(1, "z")); // duplicate left
+  EXPECT_FALSE(m.insert(9, "b")); // duplicate right
+  EXPECT_FALSE(m.promoted());
+  EXPECT_EQ(m.size(), 3);
+  EXPECT_EQ(*m.find_left(2), "b");
+  EXPECT_EQ(*m.find_right("c"), 3);
+  EXPECT_EQ(m.find_left(7), nullptr);
+  EXPECT_EQ(m.at_left(1), "a");
+  EXPECT_THROW(m.at_right("q"), std::out_of_range);
+
+  EXPECT_TRUE(m.erase_right("a"));
+  EXPECT_FALSE(m.erase_left(1));
+  EXPECT_EQ(m.size(), 2);
+  EXPECT_TRUE(m.insert(1, "a"));
+  EXPECT_TRUE(m.insert(4, "d"));
+  EXPECT_FALSE(m.promoted()); // exactly at the threshold
+
+  EXPECT_TRUE(m.insert(5, "e")); // crosses it
+  EXPECT_TRUE(m.promoted());
+  EXPECT_EQ(m.size(), 5);
+  EXPECT_EQ(*m.find_left(3), "c");
+  EXPECT_FALSE(m.insert(5, "x"));
+  EXPECT_TRUE(m.erase_left(2));
+
+  std::vector<int> lefts;
+  m.for_each([&lefts](int l, std::string const &) { lefts.push_back(l); });
+  EXPECT_EQ(lefts, (std::vector<int>{1, 3, 4, 5}));
+}
+
+TEST(bimap_ingest, ordered_application) {
+  bimap_ingest<int, int> q;
+  bimap<int, int> reference;
+  // interleaved inserts and erases must apply in arrival order, including
+  // an erase between two inserts of the same key
+  q.enqueue_insert(1, 10);
+  q.enqueue_insert(2, 20);
+  q.enqueue_insert(1, 99); // duplicate left, dropped like sequential insert
+  q.enqueue_erase_left(1);
+  q.enqueue_insert(1, 11); // reinserted after the erase: must land
+  q.enqueue_erase_right(20);
+  q.enqueue_insert(3, 30);
+  // duplicate right inside one run: (5,100) arrives first and must win,
+  // not the smaller left that a single batch would prefer
+  q.enqueue_insert(5, 100);
+  q.enqueue_insert(4, 100);
+  reference.insert(1, 10);
+  reference.insert(2, 20);
+  reference.insert(1, 99);
+  reference.erase_left(1);
+  reference.insert(1, 11);
+  reference.erase_right(20);
+  reference.insert(3, 30);
+  reference.insert(5, 100);
+  reference.insert(4, 100);
+
+  EXPECT_EQ(q.apply_pending(), 9);
+  EXPECT_EQ(q.map(), reference);
+  EXPECT_EQ(q.map().find_right(100).flip(), q.map().find_left(5));
+  EXPECT_EQ(q.apply_pending(), 0); // queue fully drained
+}
+
+TEST(bimap_ingest, concurrent_producers) {
+  bimap_ingest<uint32_t, uint32_t> q;
+  constexpr uint32_t per_thread = 5000;
+  std::vector<std::thread> producers;
+  for (uint32_t t = 0; t < 4; t++) {
+    producers.emplace_back([&q, t] {
+      for (uint32_t i = 0; i < per_thread; i++) {
+        q.enqueue_insert(t * per_thread + i, 1000000 + t * per_thread + i);
+      }
+    });
+  }
+  // the consumer drains concurrently with the producers; bounded staleness,
+  // never a torn queue
+  std::atomic<bool> done{false};
+  size_t applied = 0;
+  std::thread consumer([&] {
+    while (!done) {
+      applied += q.apply_pending();
+    }
+  });
+  for (auto &p : producers) {
+    p.join();
+  }
+  done = true;
+  consumer.join();
+  applied += q.apply_pending();
+  EXPECT_EQ(applied, 4 * per_thread);
+  EXPECT_EQ(q.map().size(), 4 * per_thread);
+  EXPECT_EQ(q.map().at_left(12345), 1012345);
+}
+
+TEST(bimap, keyed_erase_miss_keeps_order_stats) {
+  bimap<int, int> b;
+  for (int i = 0; i < 100; i++) {
+    b.insert(i, i + 1000);
+  }
+  // a missed keyed erase must roll back its provisional size decrements
+  EXPECT_FALSE(b.erase_left(500));
+  EXPECT_FALSE(b.erase_right(500));
+  EXPECT_EQ(b.size(), 100);
+  EXPECT_EQ(b.rank_left(50), 50);
+  EXPECT_EQ(*b.nth_left(99), 99);
+  EXPECT_TRUE(b.erase_left(50));
+  EXPECT_EQ(b.rank_left(99), 98);
+  EXPECT_EQ(*b.nth_right(0), 1000);
+}
+
+TEST(bimap, emplace) {
+  bimap<std::string, std::string> b;
+  auto it = b.emplace(std::make_tuple(3, 'a'), std::make_tuple(2, 'b'));
+  ASSERT_NE(it, b.end_left());
+  EXPECT_EQ(*it, "aaa");
+  EXPECT_EQ(*it.flip(), "bb");
+  // either key clashing must reject and free the node
+  EXPECT_EQ(b.emplace(std::make_tuple(3, 'a'), std::make_tuple(1, 'c')),
+            b.end_left());
+  EXPECT_EQ(b.emplace(std::make_tuple(1, 'd'), std::make_tuple(2, 'b')),
+            b.end_left());
+  EXPECT_EQ(b.size(), 1);
+}
+
+TEST(bimap, extract_and_rekey) {
+  bimap<int, int> b;
+  b.insert(1, 10);
+  b.insert(2, 20);
+  b.insert(3, 30);
+
+  auto nh = b.extract_left(b.find_left(2));
+  EXPECT_EQ(b.size(), 2);
+  EXPECT_EQ(b.find_left(2), b.end_left());
+  nh.left() = 5;
+  ASSERT_NE(b.insert(std::move(nh)), b.end_left());
+  EXPECT_EQ(b.at_left(5), 20);
+  EXPECT_EQ(b.size(), 3);
+
+  // conflicting reinsertion keeps the node in the handle
+  auto nh2 = b.extract_right(b.find_right(30));
+  nh2.right() = 20;
+  EXPECT_EQ(b.insert(std::move(nh2)), b.end_left());
+  EXPECT_FALSE(nh2.empty());
+  nh2.right() = 40;
+  ASSERT_NE(b.insert(std::move(nh2)), b.end_left());
+  EXPECT_EQ(b.at_right(40), 3);
+
+  // a dropped handle must free its node (checked by the sanitizer build)
+  auto dropped = b.extract_left(b.begin_left());
+  EXPECT_FALSE(dropped.empty());
+}
+
+TEST(bimap, snapshot_roundtrip) {
+  bimap<int64_t, int64_t> b;
+  std::mt19937 e(std::random_device{}());
+  for (size_t i = 0; i < 5000; i++) {
+    b.insert(static_cast<int64_t>(e()), static_cast<int64_t>(e()));
+  }
+  const char *path = "bimap_snapshot_test.bin";
+  ASSERT_TRUE(b.save(path));
+
+  bimap<int64_t, int64_t> loaded;
+  loaded.insert(1, 2); // must be replaced by load
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(loaded, b);
+
+  // loaded map must be fully functional
+  loaded.erase_left(loaded.begin_left());
+  loaded.insert(-1, -2);
+  EXPECT_EQ(loaded.size(), b.size());
+
+  bimap<int64_t, int64_t> untouched;
+  EXPECT_FALSE(untouched.load("nonexistent_snapshot.bin"));
+  EXPECT_TRUE(untouched.empty());
+  std::remove(path);
+}
+
+TEST(bimap, snapshot_rejects_duplicate_index) {
+  bimap<int64_t, int64_t> b;
+  for (int64_t i = 0; i < 3; i++) {
+    b.insert(i, i + 10);
+  }
+  const char *path = "bimap_snapshot_dup_test.bin";
+  ASSERT_TRUE(b.save(path));
+  // overwrite the last right-order index with a copy of the first one: every
+  // index stays < count, but the block is no longer a permutation
+  std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+  ASSERT_TRUE(bool(f));
+  std::streamoff indices = 4 + 8 + 3 * (8 + 8 + 4 + 4);
+  uint32_t first = 0;
+  f.seekg(indices);
+  f.read(reinterpret_cast<char *>(&first), sizeof first);
+  f.seekp(indices + 2 * std::streamoff(sizeof(uint32_t)));
+  f.write(reinterpret_cast<char const *>(&first), sizeof first);
+  f.close();
+
+  bimap<int64_t, int64_t> loaded;
+  loaded.insert(100, 200);
+  EXPECT_FALSE(loaded.load(path));
+  EXPECT_EQ(loaded.size(), 1);
+  EXPECT_EQ(loaded.at_left(100), 200);
+  std::remove(path);
+}
+
+TEST(bimap, snapshot_rejects_unordered_keys) {
+  bimap<int64_t, int64_t> b;
+  for (int64_t i = 0; i < 3; i++) {
+    b.insert(i, i + 10);
+  }
+  const char *path = "bimap_snapshot_order_test.bin";
+  ASSERT_TRUE(b.save(path));
+  // swap the first two node records: magic, count and permutation all stay
+  // valid, but the left keys are no longer ascending
+  char rec0[24];
+  char rec1[24];
+  {
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    ASSERT_TRUE(bool(f));
+    f.seekg(12);
+    f.read(rec0, sizeof rec0);
+    f.read(rec1, sizeof rec1);
+    f.seekp(12);
+    f.write(rec1, sizeof rec1);
+    f.write(rec0, sizeof rec0);
+  }
+  bimap<int64_t, int64_t> loaded;
+  loaded.insert(100, 200);
+  EXPECT_FALSE(loaded.load(path));
+  EXPECT_EQ(loaded.size(), 1);
+
+  // swap two entries of an otherwise valid permutation instead: still a
+  // permutation, but the right keys it walks are out of order
+  ASSERT_TRUE(b.save(path));
+  {
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    ASSERT_TRUE(bool(f));
+    std::streamoff indices = 12 + 3 * 24;
+    uint32_t i0, i1;
+    f.seekg(indices);
+    f.read(reinterpret_cast<char *>(&i0), sizeof i0);
+    f.read(reinterpret_cast<char *>(&i1), sizeof i1);
+    f.seekp(indices);
+    f.write(reinterpret_cast<char const *>(&i1), sizeof i1);
+    f.write(reinterpret_cast<char const *>(&i0), sizeof i0);
+  }
+  EXPECT_FALSE(loaded.load(path));
+  EXPECT_EQ(loaded.size(), 1);
+  EXPECT_EQ(loaded.at_left(100), 200);
+  std::remove(path);
+}
+
+TEST(bimap, pool_allocator_snapshot_load) {
+  // load builds nodes from the pool before replacing the old contents, so
+  // the bulk release path must not run on the drain
+  using pooled_bimap =
+      bimap<int64_t, int64_t, std::less<int64_t>, std::less<int64_t>,
+            pool_allocator<std::pair<int64_t, int64_t>>>;
+  pooled_bimap b;
+  for (int64_t i = 0; i < 1000; i++) {
+    b.insert(i, i + 100000);
+  }
+  const char *path = "bimap_snapshot_pool_test.bin";
+  ASSERT_TRUE(b.save(path));
+
+  pooled_bimap loaded;
+  for (int64_t i = 0; i < 300; i++) {
+    loaded.insert(-i, -i - 100000);
+  }
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(loaded, b);
+  loaded.insert(-1, -1);
+  EXPECT_EQ(loaded.size(), b.size() + 1);
+  std::remove(path);
+}
+
+TEST(bimap, copy_is_independent) {
+  bimap<uint32_t, uint32_t> b;
+  std::mt19937 e(std::random_device{}());
+  for (size_t i = 0; i < 10000; i++) {
+    b.insert(e(), e());
+  }
+  bimap<uint32_t, uint32_t> copy(b);
+  EXPECT_EQ(copy, b);
+  size_t original = b.size();
+  while (copy.size() > original / 2) {
+    copy.erase_left(copy.begin_left());
+  }
+  EXPECT_EQ(b.size(), original);
+  EXPECT_EQ(*b.begin_left(), *b.nth_left(0));
+}
+
+TEST(bimap, transparent_lookup) {
+  bimap<std::string, std::string, std::less<>, std::less<>> b;
+  b.insert("alpha", "a");
+  b.insert("beta", "b");
+  b.insert("gamma", "c");
+
+  // no std::string is constructed for any of these probes
+  std::string_view key = "beta";
+  EXPECT_EQ(*b.find_left(key).flip(), "b");
+  EXPECT_EQ(b.at_left(key), "b");
+  EXPECT_EQ(b.at_right(std::string_view("c")), "gamma");
+  EXPECT_EQ(*b.lower_bound_left(std::string_view("b")), "beta");
+  EXPECT_EQ(*b.upper_bound_left(key), "gamma");
+  EXPECT_EQ(b.find_left(std::string_view("delta")), b.end_left());
+  EXPECT_EQ(*b.find_right(std::string_view("c")).flip(), "gamma");
+  EXPECT_EQ(b.rank_left(std::string_view("b")), 1);
+}
+
+TEST(bimap, iterator_conformance) {
+  bimap<int, std::string> b;
+  b.insert(1, "one");
+  b.insert(2, "two");
+  b.insert(3, "three");
+
+  static_assert(
+      std::is_same_v<
+          std::iterator_traits<bimap<int, std::string>::left_iterator>::
+              iterator_category,
+          std::bidirectional_iterator_tag>);
+  EXPECT_EQ(std::distance(b.begin_left(), b.end_left()), 3);
+  EXPECT_EQ(*std::prev(b.end_left()), 3);
+  EXPECT_EQ(std::next(b.begin_right())->size(), 5); // "three"
+
+  int sum = 0;
+  std::for_each(b.begin_left(), b.end_left(), [&sum](int x) { sum += x; });
+  EXPECT_EQ(sum, 6);
+}
+
+TEST(bimap, parallel_for_each) {
+  bimap<uint32_t, uint32_t> b;
+  uint64_t left_sum = 0, right_sum = 0;
+  for (uint32_t i = 0; i < 10000; i++) {
+    b.insert(i * 7 % 10000, i * 13 % 10000);
+    left_sum += i * 7 % 10000;
+    right_sum += i * 13 % 10000;
+  }
+  std::atomic<uint64_t> l{0}, r{0};
+  parallel_for_each_left(b, 4, [&](uint32_t left, uint32_t right) {
+    l += left;
+    r += right;
+  });
+  EXPECT_EQ(l.load(), left_sum);
+  EXPECT_EQ(r.load(), right_sum);
+
+  l = r = 0;
+  parallel_for_each_right(b, 4, [&](uint32_t right, uint32_t left) {
+    l += left;
+    r += right;
+  });
+  EXPECT_EQ(l.load(), left_sum);
+  EXPECT_EQ(r.load(), right_sum);
+
+  // more threads than elements degrades to fewer workers, not to a crash
+  bimap<uint32_t, uint32_t> tiny;
+  tiny.insert(1, 2);
+  uint32_t seen = 0;
+  parallel_for_each_left(tiny, 16,
+                         [&seen](uint32_t left, uint32_t) { seen += left; });
+  EXPECT_EQ(seen, 1);
+}
+
+TEST(bimap, seeded_priorities) {
+  bimap<int, int> a(uint64_t(42));
+  bimap<int, int> b(uint64_t(42));
+  std::mt19937 e(std::random_device{}());
+  for (size_t i = 0; i < 1000; i++) {
+    uint32_t l = e() % 10000, r = e() % 10000;
+    a.insert(l, r);
+    b.insert(l, r);
+  }
+  EXPECT_EQ(a, b);
+  for (size_t i = 0; i < a.size(); i++) {
+    EXPECT_EQ(*a.nth_left(i), *b.nth_left(i));
+  }
+}
+
+TEST(bimap, ordered_projection) {
+  bimap<uint32_t, uint32_t> b;
+  std::mt19937 e(std::random_device{}());
+  for (size_t i = 0; i < 500; i++) {
+    b.insert(e() % 1000, e() % 1000);
+  }
+  // brute force: left-range filter, then right-order sort of the survivors
+  std::vector<std::pair<uint32_t, uint32_t>> expected;
+  for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+    if (*it >= 200 && *it < 700) {
+      expected.emplace_back(*it.flip(), *it);
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+
+  auto res = b.ordered_right_within_left_range(200, 700);
+  ASSERT_EQ(res.size(), expected.size());
+  for (size_t i = 0; i < res.size(); i++) {
+    EXPECT_EQ(*res[i], expected[i].first);
+    EXPECT_EQ(*res[i].flip(), expected[i].second);
+  }
+
+  EXPECT_TRUE(b.ordered_right_within_left_range(500, 500).empty());
+  EXPECT_TRUE(b.ordered_right_within_left_range(5000, 9000).empty());
+
+  // the symmetric projection agrees with the count of the filtering side
+  auto sym = b.ordered_left_within_right_range(100, 300);
+  EXPECT_EQ(sym.size(), b.count_range_right(100, 300));
+  for (size_t i = 1; i < sym.size(); i++) {
+    EXPECT_LT(*sym[i - 1], *sym[i]);
+  }
+}
+
+TEST(bimap, stats_policy) {
+  using stats_bimap =
+      bimap<int, int, std::less<int>, std::less<int>,
+            std::allocator<std::pair<int, int>>, with_stats>;
+  stats_bimap b;
+  for (int i = 0; i < 100; i++) {
+    b.insert(i, i + 1000);
+  }
+  b.insert(5, 9999); // rejected duplicate: not an insert, still comparisons
+  b.find_left(50);
+  b.find_left(-1);
+  b.find_right(1050);
+  b.erase_left(10);
+  b.erase_right(1020);
+  b.erase_right(-5); // miss
+
+  auto s = b.stats();
+  EXPECT_EQ(s.inserts, 100);
+  EXPECT_EQ(s.finds, 3);
+  EXPECT_EQ(s.erases, 2);
+  EXPECT_EQ(s.allocations, 100); // the rejected duplicate never allocated
+  EXPECT_EQ(s.deallocations, 2);
+  EXPECT_EQ(s.live_nodes, 98);
+  EXPECT_GT(s.comparisons_left, 0);
+  EXPECT_GT(s.comparisons_right, 0);
+
+  auto d = b.depth_stats_left();
+  uint64_t nodes = 0;
+  for (uint64_t bucket : d.histogram) {
+    nodes += bucket;
+  }
+  EXPECT_EQ(nodes, b.size());
+  EXPECT_EQ(d.histogram[0], 1); // exactly one root
+  EXPECT_GE(d.max_depth, 6);    // 98 nodes need depth >= log2
+  EXPECT_LE(d.avg_depth, double(d.max_depth));
+  // available without the stats policy too
+  bimap<int, int> plain;
+  plain.insert(1, 2);
+  EXPECT_EQ(plain.depth_stats_right().max_depth, 0);
+}
+
+namespace {
+struct counting_less {
+  static inline size_t count = 0;
+  bool operator()(int a, int b) const {
+    ++count;
+    return a < b;
+  }
+};
+} // namespace
+
+TEST(bimap, sorted_append_fast_path) {
+  // monotone ingest hits the one-comparison boundary probe on both sides:
+  // linear total comparisons instead of n log n
+  const int n = 10000;
+  bimap<int, int, counting_less, counting_less> b;
+  counting_less::count = 0;
+  for (int i = 0; i < n; i++) {
+    b.insert(i, i);
+  }
+  EXPECT_EQ(b.size(), n);
+  EXPECT_LT(counting_less::count, 4 * size_t(n));
+
+  // descending keys take the symmetric minimum-prepend path
+  bimap<int, int, counting_less, counting_less> d;
+  counting_less::count = 0;
+  for (int i = n; i > 0; i--) {
+    d.insert(i, i);
+  }
+  EXPECT_EQ(d.size(), n);
+  EXPECT_LT(counting_less::count, 4 * size_t(n));
+
+  // the trees behave like any other after the fast-path build
+  EXPECT_EQ(*b.nth_left(5000), 5000);
+  EXPECT_EQ(b.rank_right(2500), 2500u);
+  EXPECT_EQ(b.find_left(n), b.end_left());
+  EXPECT_TRUE(b.erase_left(0));
+  EXPECT_EQ(*b.begin_left(), 1);
+  EXPECT_EQ(b.insert(20000, 1), b.end_left()); // right key taken
+}
+
+TEST(bimap, bulk_construction) {
+  std::vector<std::pair<int, int>> data = {
+      {1, 10}, {2, 20}, {3, 30}, {4, 40}, {5, 50}};
+
+  bimap<int, int> from_range(data.begin(), data.end());
+  bimap<int, int> reference;
+  for (auto const &p : data) {
+    reference.insert(p.first, p.second);
+  }
+  EXPECT_EQ(from_range, reference);
+
+  std::shuffle(data.begin(), data.end(), std::mt19937(std::random_device{}()));
+  bimap<int, int> from_unsorted;
+  from_unsorted.assign(data.begin(), data.end());
+  EXPECT_EQ(from_unsorted, reference);
+}
+
+TEST(bimap, bulk_construction_duplicates) {
+  // the pair with the smaller left key wins on either kind of collision
+  std::vector<std::pair<int, int>> data = {
+      {1, 10}, {2, 10}, {3, 30}, {3, 40}, {5, 50}};
+  bimap<int, int> b(data.begin(), data.end());
+
+  EXPECT_EQ(b.size(), 3);
+  EXPECT_EQ(b.at_left(1), 10);
+  EXPECT_EQ(b.find_left(2), b.end_left());
+  EXPECT_EQ(b.at_left(3), 30);
+  EXPECT_EQ(b.at_left(5), 50);
+}
+
+TEST(bimap, pop_min_drain) {
+  bimap<uint32_t, uint32_t> b;
+  std::mt19937 e(std::random_device{}());
+  for (size_t i = 0; i < 10000; i++) {
+    b.insert(e(), e());
+  }
+  // the consumer pattern: repeatedly take and erase the minimal left
+  uint32_t prev = 0;
+  bool has_prev = false;
+  while (!b.empty()) {
+    uint32_t min = *b.begin_left();
+    if (has_prev) {
+      EXPECT_LT(prev, min);
+    }
+    prev = min;
+    has_prev = true;
+    b.erase_left(b.begin_left());
+  }
+  EXPECT_EQ(b.begin_left(), b.end_left());
+}
+
 TEST(bimap, simple) {
   bimap<int, int> b;
   b.insert(4, 4);
@@ -295,6 +977,336 @@ TEST(bimap_randomized, comparison) {
   EXPECT_EQ(b1, b2);
 }
 
+TEST(bimap_randomized, bulk_construction) {
+  std::mt19937 e(seed);
+  std::vector<std::pair<uint32_t, uint32_t>> data(10000);
+  for (auto &p : data) {
+    p = {e() % 30000, e() % 30000};
+  }
+
+  bimap<uint32_t, uint32_t> reference;
+  std::vector<std::pair<uint32_t, uint32_t>> accepted;
+  std::sort(data.begin(), data.end());
+  for (auto const &p : data) {
+    if (reference.insert(p.first, p.second) != reference.end_left()) {
+      accepted.push_back(p);
+    }
+  }
+
+  bimap<uint32_t, uint32_t> bulk(accepted.begin(), accepted.end());
+  EXPECT_EQ(bulk, reference);
+}
+
+TEST(bimap_randomized, erase_range) {
+  std::mt19937 e(seed);
+  bimap<uint32_t, uint32_t> b;
+  std::map<uint32_t, uint32_t> left_view;
+  for (size_t i = 0; i < 10000; i++) {
+    uint32_t l = e() % 100000, r = e() % 100000;
+    if (b.insert(l, r) != b.end_left()) {
+      left_view.insert({l, r});
+    }
+  }
+
+  while (!b.empty()) {
+    uint32_t lo = e() % 100000, hi = e() % 100000;
+    if (hi < lo) {
+      std::swap(lo, hi);
+    }
+    b.erase_left(b.lower_bound_left(lo), b.lower_bound_left(hi));
+    left_view.erase(left_view.lower_bound(lo), left_view.lower_bound(hi));
+
+    EXPECT_EQ(b.size(), left_view.size());
+    auto lit = b.begin_left();
+    for (auto const &p : left_view) {
+      EXPECT_EQ(*lit, p.first);
+      EXPECT_EQ(*lit.flip(), p.second);
+      ++lit;
+    }
+    if (e() % 4 == 0 && !b.empty()) {
+      // exercise the right side and the erase-to-end case too
+      auto from = b.lower_bound_right(e() % 100000);
+      for (auto it = from; it != b.end_right(); ++it) {
+        left_view.erase(*it.flip());
+      }
+      b.erase_right(from, b.end_right());
+      EXPECT_EQ(b.size(), left_view.size());
+    }
+  }
+}
+
+TEST(bimap_randomized, batch_insert) {
+  std::mt19937 e(seed);
+  bimap<uint32_t, uint32_t> b;
+  bimap<uint32_t, uint32_t> reference;
+
+  for (size_t round = 0; round < 20; round++) {
+    std::vector<std::pair<uint32_t, uint32_t>> batch(1000);
+    for (auto &p : batch) {
+      p = {e() % 50000, e() % 50000};
+    }
+    // reference applies the batch pair by pair in left order, which matches
+    // the documented smaller-left-wins conflict resolution
+    auto sorted = batch;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](auto const &a, auto const &b) {
+                       return a.first < b.first;
+                     });
+    size_t expected = 0;
+    for (auto const &p : sorted) {
+      if (reference.insert(p.first, p.second) != reference.end_left()) {
+        expected++;
+      }
+    }
+    EXPECT_EQ(b.insert(std::move(batch)), expected);
+    EXPECT_EQ(b, reference);
+  }
+}
+
+TEST(bimap_randomized, order_statistics) {
+  std::mt19937 e(seed);
+  bimap<uint32_t, uint32_t> b;
+  std::vector<uint32_t> lefts;
+  for (size_t i = 0; i < 10000; i++) {
+    uint32_t l = e() % 1000000, r = e() % 1000000;
+    if (b.insert(l, r) != b.end_left()) {
+      lefts.push_back(l);
+    }
+  }
+  std::sort(lefts.begin(), lefts.end());
+
+  for (size_t i = 0; i < 1000; i++) {
+    size_t k = e() % lefts.size();
+    EXPECT_EQ(*b.nth_left(k), lefts[k]);
+    uint32_t probe = e() % 1000000;
+    EXPECT_EQ(b.rank_left(probe),
+              std::lower_bound(lefts.begin(), lefts.end(), probe) -
+                  lefts.begin());
+  }
+  EXPECT_EQ(b.nth_left(lefts.size()), b.end_left());
+  EXPECT_EQ(b.nth_right(b.size() - 1).flip() == b.end_left(), false);
+
+  // distance agrees with element-wise iteration
+  auto mid = b.nth_left(lefts.size() / 2);
+  EXPECT_EQ(b.distance_left(b.begin_left(), mid), lefts.size() / 2);
+  EXPECT_EQ(b.distance_left(mid, b.end_left()),
+            lefts.size() - lefts.size() / 2);
+  EXPECT_EQ(b.distance_right(b.begin_right(), b.end_right()), b.size());
+
+  // sizes stay correct under erasure
+  for (size_t i = 0; i < 1000; i++) {
+    auto it = b.end_left();
+    while (it == b.end_left()) {
+      it = b.lower_bound_left(e() % 1000000);
+    }
+    lefts.erase(std::lower_bound(lefts.begin(), lefts.end(), *it));
+    b.erase_left(it);
+    size_t k = e() % lefts.size();
+    EXPECT_EQ(*b.nth_left(k), lefts[k]);
+  }
+}
+
+TEST(bimap_randomized, range_queries) {
+  std::mt19937 e(seed);
+  bimap<uint32_t, uint32_t> b;
+  std::vector<uint32_t> lefts;
+  for (size_t i = 0; i < 10000; i++) {
+    uint32_t l = e() % 100000, r = e() % 100000;
+    if (b.insert(l, r) != b.end_left()) {
+      lefts.push_back(l);
+    }
+  }
+  std::sort(lefts.begin(), lefts.end());
+
+  for (size_t i = 0; i < 1000; i++) {
+    uint32_t lo = e() % 100000, hi = e() % 100000;
+    if (hi < lo) {
+      std::swap(lo, hi);
+    }
+    auto range = b.equal_range_left(lo, hi);
+    EXPECT_EQ(range.first, b.lower_bound_left(lo));
+    EXPECT_EQ(range.second, b.lower_bound_left(hi));
+    size_t expected = std::lower_bound(lefts.begin(), lefts.end(), hi) -
+                      std::lower_bound(lefts.begin(), lefts.end(), lo);
+    EXPECT_EQ(b.count_range_left(lo, hi), expected);
+    EXPECT_EQ(b.distance_left(range.first, range.second), expected);
+  }
+  EXPECT_EQ(b.count_range_right(50, 50), 0);
+  EXPECT_EQ(b.count_range_right(50, 40), 0);
+  auto all = b.equal_range_right(0, 100000);
+  EXPECT_EQ(all.first, b.begin_right());
+  EXPECT_EQ(all.second, b.end_right());
+}
+
+TEST(bimap, merge_steals_nonconflicting) {
+  bimap<int, int> a;
+  a.insert(1, 10);
+  a.insert(2, 20);
+  bimap<int, int> b;
+  b.insert(3, 30);  // clean
+  b.insert(2, 300); // left conflict
+  b.insert(4, 10);  // right conflict
+  b.insert(5, 50);  // clean
+
+  EXPECT_EQ(a.merge(b), 2);
+  EXPECT_EQ(a.size(), 4);
+  EXPECT_EQ(b.size(), 2);
+  EXPECT_EQ(a.at_left(3), 30);
+  EXPECT_EQ(a.at_left(5), 50);
+  EXPECT_EQ(b.at_left(2), 300);
+  EXPECT_EQ(b.at_left(4), 10);
+  // both maps stay fully usable
+  a.insert(6, 60);
+  b.erase_left(2);
+  EXPECT_EQ(a.rank_left(100), 5);
+  EXPECT_EQ(b.size(), 1);
+  EXPECT_EQ(a.merge(bimap<int, int>()), 0);
+}
+
+TEST(bimap, diff_lists_added_and_removed) {
+  bimap<int, int> from;
+  from.insert(1, 10);
+  from.insert(2, 20);
+  from.insert(3, 30);
+  bimap<int, int> to;
+  to.insert(2, 20);  // unchanged
+  to.insert(3, 300); // re-paired
+  to.insert(4, 40);  // new
+
+  auto d = diff(from, to);
+  ASSERT_EQ(d.removed.size(), 2);
+  EXPECT_EQ(d.removed[0], std::make_pair(1, 10));
+  EXPECT_EQ(d.removed[1], std::make_pair(3, 30));
+  ASSERT_EQ(d.added.size(), 2);
+  EXPECT_EQ(d.added[0], std::make_pair(3, 300));
+  EXPECT_EQ(d.added[1], std::make_pair(4, 40));
+
+  // applying the diff reconciles from into to
+  for (auto const &p : d.removed) {
+    from.erase_left(p.first);
+  }
+  for (auto const &p : d.added) {
+    from.insert(p.first, p.second);
+  }
+  EXPECT_EQ(from, to);
+  EXPECT_TRUE(diff(from, to).added.empty());
+  EXPECT_TRUE(diff(from, to).removed.empty());
+}
+
+TEST(bimap_randomized, hash_index_mode) {
+  using indexed_bimap =
+      bimap<uint32_t, uint32_t, std::less<uint32_t>, std::less<uint32_t>,
+            std::allocator<std::pair<uint32_t, uint32_t>>, with_hash_index>;
+  std::mt19937 e(seed);
+  indexed_bimap b;
+  bimap<uint32_t, uint32_t> reference;
+  for (size_t i = 0; i < 30000; i++) {
+    uint32_t op = e() % 10, l = e() % 10000, r = e() % 10000;
+    if (op < 6) {
+      EXPECT_EQ(b.insert(l, r) != b.end_left(),
+                reference.insert(l, r) != reference.end_left());
+    } else if (op < 8) {
+      EXPECT_EQ(b.erase_left(l), reference.erase_left(l));
+    } else {
+      EXPECT_EQ(b.erase_right(r), reference.erase_right(r));
+    }
+    uint32_t probe = e() % 10000;
+    EXPECT_EQ(b.find_left(probe) == b.end_left(),
+              reference.find_left(probe) == reference.end_left());
+    if (b.find_left(probe) != b.end_left()) {
+      EXPECT_EQ(b.at_left(probe), reference.at_left(probe));
+    }
+    EXPECT_EQ(b.find_right(probe) == b.end_right(),
+              reference.find_right(probe) == reference.end_right());
+  }
+  EXPECT_EQ(b.size(), reference.size());
+  // ordered queries stay on the trees and must be untouched by the index
+  EXPECT_EQ(*b.begin_left(), *reference.begin_left());
+  EXPECT_EQ(*b.lower_bound_left(5000), *reference.lower_bound_left(5000));
+}
+
+TEST(bimap_randomized, finger_search_mode) {
+  using finger_bimap =
+      bimap<uint32_t, uint32_t, std::less<uint32_t>, std::less<uint32_t>,
+            std::allocator<std::pair<uint32_t, uint32_t>>, with_finger_search>;
+  std::mt19937 e(seed);
+  finger_bimap b;
+  bimap<uint32_t, uint32_t> reference;
+  // probes random-walk around a drifting center so consecutive lookups are
+  // close in key space (the workload the finger is meant for); erases of the
+  // just-probed key exercise finger invalidation
+  uint32_t center = 50000;
+  for (size_t i = 0; i < 30000; i++) {
+    uint32_t op = e() % 10;
+    center = (center + e() % 200) % 100000;
+    uint32_t probe = (center + e() % 50) % 100000;
+    if (op < 5) {
+      uint32_t r = e() % 100000;
+      EXPECT_EQ(b.insert(probe, r) != b.end_left(),
+                reference.insert(probe, r) != reference.end_left());
+    } else if (op == 5) {
+      EXPECT_EQ(b.erase_left(probe), reference.erase_left(probe));
+    } else if (op == 6) {
+      EXPECT_EQ(b.erase_right(probe), reference.erase_right(probe));
+    } else if (op == 7) {
+      auto it = b.lower_bound_left(probe);
+      auto ref_it = reference.lower_bound_left(probe);
+      EXPECT_EQ(it == b.end_left(), ref_it == reference.end_left());
+      if (it != b.end_left()) {
+        EXPECT_EQ(*it, *ref_it);
+      }
+    } else {
+      EXPECT_EQ(b.find_left(probe) == b.end_left(),
+                reference.find_left(probe) == reference.end_left());
+      EXPECT_EQ(b.find_right(probe) == b.end_right(),
+                reference.find_right(probe) == reference.end_right());
+    }
+  }
+  EXPECT_EQ(b.size(), reference.size());
+  // a far jump right after a clustered run still has to land correctly
+  EXPECT_EQ(b.find_left(7) == b.end_left(),
+            reference.find_left(7) == reference.end_left());
+  EXPECT_EQ(*b.lower_bound_right(0), *reference.lower_bound_right(0));
+}
+
+TEST(bimap_randomized, small_bimap_reference) {
+  // a low threshold and a narrow key range keep the map hovering around the
+  // promotion boundary for the first part of the run
+  small_bimap<uint32_t, uint32_t, std::less<uint32_t>, std::less<uint32_t>, 8>
+      m;
+  bimap<uint32_t, uint32_t> reference;
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 20000; i++) {
+    uint32_t op = e() % 10, l = e() % 50, r = e() % 50;
+    if (op < 5) {
+      EXPECT_EQ(m.insert(l, r),
+                reference.insert(l, r) != reference.end_left());
+    } else if (op < 7) {
+      EXPECT_EQ(m.erase_left(l), reference.erase_left(l));
+    } else if (op < 9) {
+      EXPECT_EQ(m.erase_right(r), reference.erase_right(r));
+    } else {
+      EXPECT_EQ(m.find_left(l) != nullptr,
+                reference.find_left(l) != reference.end_left());
+      if (m.find_left(l) != nullptr) {
+        EXPECT_EQ(*m.find_left(l), reference.at_left(l));
+      }
+      EXPECT_EQ(m.find_right(r) != nullptr,
+                reference.find_right(r) != reference.end_right());
+    }
+    EXPECT_EQ(m.size(), reference.size());
+  }
+  std::vector<std::pair<uint32_t, uint32_t>> seen;
+  m.for_each([&seen](uint32_t l, uint32_t r) { seen.emplace_back(l, r); });
+  EXPECT_EQ(seen.size(), reference.size());
+  size_t i = 0;
+  for (auto it = reference.begin_left(); it != reference.end_left();
+       ++it, ++i) {
+    EXPECT_EQ(seen[i].first, *it);
+    EXPECT_EQ(seen[i].second, *it.flip());
+  }
+}
+
 TEST(bimap_randomized, invariant_check) {
   std::cout << "Seed used for randomized invariant test is " << seed
             << std::endl;
@@ -399,6 +1411,24 @@ TEST(bimap, assigment) {
   EXPECT_EQ(a, b);
 }
 
+TEST(bimap, move_construction) {
+  bimap<int, int> a;
+  a.insert(1, 4);
+  a.insert(8, 8);
+  a.insert(25, 17);
+  auto copy = a;
+  bimap<int, int> b = std::move(a);
+  EXPECT_EQ(b, copy);
+  EXPECT_EQ(b.size(), 3);
+  // moved-from map must stay usable
+  a.insert(1, 2);
+  EXPECT_EQ(a.size(), 1);
+  bimap<int, int> c = std::move(b);
+  c.insert(100, 500);
+  EXPECT_EQ(c.size(), 4);
+  EXPECT_EQ(*c.find_left(100).flip(), 500);
+}
+
 TEST(bimap, equivalence) {
   bimap<int, int> a;
   bimap<int, int> b;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Slab allocator for fixed-size node objects: carves T-sized slots out of
+// large contiguous chunks and free-lists erased slots for reuse. Intended as
+// the Allocator parameter of bimap when pairs are allocated and freed in
+// bulk; release_all() lets teardown drop whole chunks instead of N frees.
+template <typename T, std::size_t ChunkElems = 1024> struct pool_allocator {
+  using value_type = T;
+
+  template <typename U> struct rebind {
+    using other = pool_allocator<U, ChunkElems>;
+  };
+
+  pool_allocator() = default;
+
+  // a copy is an independent empty pool: pooled storage is never shared
+  pool_allocator(const pool_allocator &) noexcept {}
+
+  template <typename U>
+  explicit pool_allocator(const pool_allocator<U, ChunkElems> &) noexcept {}
+
+  pool_allocator(pool_allocator &&other) noexcept { swap(other); }
+
+  pool_allocator &operator=(pool_allocator &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~pool_allocator() { release_all(); }
+
+  void swap(pool_allocator &other) noexcept {
+    std::swap(chunks, other.chunks);
+    std::swap(free_list, other.free_list);
+    std::swap(used_in_last, other.used_in_last);
+  }
+
+  T *allocate(std::size_t n) {
+    if (n != 1) {
+      // the pool only hands out single slots; bulk requests bypass it
+      return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    if (free_list != nullptr) {
+      slot *res = free_list;
+      free_list = free_list->next;
+      return reinterpret_cast<T *>(res);
+    }
+    if (used_in_last == ChunkElems) {
+      chunks.push_back(new slot[ChunkElems]);
+      used_in_last = 0;
+    }
+    return reinterpret_cast<T *>(chunks.back() + used_in_last++);
+  }
+
+  void deallocate(T *ptr, std::size_t n) noexcept {
+    if (n != 1) {
+      ::operator delete(ptr);
+      return;
+    }
+    auto *freed = reinterpret_cast<slot *>(ptr);
+    freed->next = free_list;
+    free_list = freed;
+  }
+
+  // drops every chunk at once; all outstanding slots become invalid
+  void release_all() noexcept {
+    for (slot *chunk : chunks) {
+      delete[] chunk;
+    }
+    chunks.clear();
+    free_list = nullptr;
+    used_in_last = ChunkElems;
+  }
+
+  friend bool operator==(const pool_allocator &a,
+                         const pool_allocator &b) noexcept {
+    return &a == &b;
+  }
+
+  friend bool operator!=(const pool_allocator &a,
+                         const pool_allocator &b) noexcept {
+    return &a != &b;
+  }
+
+private:
+  // erased slots are reused as free-list links
+  union slot {
+    slot *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::vector<slot *> chunks;
+  slot *free_list = nullptr;
+  std::size_t used_in_last = ChunkElems;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Parallel traversal over a bimap. The key order is cut into `threads`
+// contiguous chunks by rank (nth_* is O(log n) per cut, so partitioning is
+// negligible next to the traversal itself) and each chunk is walked on its
+// own thread via the threaded successor links — the map is never mutated,
+// unlike a split-based partition would require.
+//
+// The callback receives the pair as (left, right) for the left order and
+// (right, left) for the right order, runs on worker threads and has to be
+// thread-safe against its other invocations. The map must not be mutated
+// concurrently; with the finger_search policy even concurrent lookups are
+// off-limits, plain iteration here is read-only either way.
+template <typename BimapT, typename F>
+void parallel_for_each_left(BimapT const &map, std::size_t threads, F f) {
+  std::size_t n = map.size();
+  threads = std::max<std::size_t>(std::min(threads, n), 1);
+  if (threads <= 1) {
+    for (auto it = map.begin_left(); it != map.end_left(); ++it) {
+      f(*it, *it.flip());
+    }
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (std::size_t t = 0; t < threads; t++) {
+    auto first = map.nth_left(n * t / threads);
+    auto last = map.nth_left(n * (t + 1) / threads);
+    workers.emplace_back([first, last, &f] {
+      for (auto it = first; it != last; ++it) {
+        f(*it, *it.flip());
+      }
+    });
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+}
+
+template <typename BimapT, typename F>
+void parallel_for_each_right(BimapT const &map, std::size_t threads, F f) {
+  std::size_t n = map.size();
+  threads = std::max<std::size_t>(std::min(threads, n), 1);
+  if (threads <= 1) {
+    for (auto it = map.begin_right(); it != map.end_right(); ++it) {
+      f(*it, *it.flip());
+    }
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (std::size_t t = 0; t < threads; t++) {
+    auto first = map.nth_right(n * t / threads);
+    auto last = map.nth_right(n * (t + 1) / threads);
+    workers.emplace_back([first, last, &f] {
+      for (auto it = first; it != last; ++it) {
+        f(*it, *it.flip());
+      }
+    });
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+
+// Read-mostly concurrent facade over bimap.
+//
+// Pairs are partitioned across Shards independent bimaps by the hash of the
+// left key. A reader takes only the shared lock of the shard it probes, so
+// lookups scale across cores; writers serialize on one ingest mutex and hold
+// a shard's exclusive lock only for the actual tree mutation, so an insert
+// burst stalls readers of one shard at a time instead of the whole map.
+//
+// Iterators are not exposed: a position is meaningless once its shard's lock
+// is released, so lookups return a copy of the paired key. Shards stay on the
+// default bimap policy — every reader path must be free of mutable state
+// under the shared lock, which rules out e.g. finger_search (its lookups
+// write the finger hint).
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename Hash = std::hash<Left>, std::size_t Shards = 16>
+struct sharded_bimap {
+  static_assert(Shards > 0, "at least one shard is required");
+
+  using map_t = bimap<Left, Right, CompareLeft, CompareRight>;
+
+  sharded_bimap() = default;
+
+  sharded_bimap(sharded_bimap const &) = delete;
+  sharded_bimap &operator=(sharded_bimap const &) = delete;
+
+  // returns false and changes nothing if either key is already present
+  bool insert(Left const &left, Right const &right) {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    shard &s = shard_of(left);
+    // only writers mutate the shard maps and they serialize on write_mutex_,
+    // so the uniqueness probes need no shard locks
+    if (s.map.find_left(left) != s.map.end_left()) {
+      return false;
+    }
+    for (shard const &other : shards_) {
+      if (other.map.find_right(right) != other.map.end_right()) {
+        return false;
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(s.mutex);
+    return s.map.insert(left, right) != s.map.end_left();
+  }
+
+  bool erase_left(Left const &left) {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    shard &s = shard_of(left);
+    if (s.map.find_left(left) == s.map.end_left()) {
+      return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(s.mutex);
+    return s.map.erase_left(left);
+  }
+
+  bool erase_right(Right const &right) {
+    std::lock_guard<std::mutex> writer(write_mutex_);
+    for (shard &s : shards_) {
+      if (s.map.find_right(right) != s.map.end_right()) {
+        std::unique_lock<std::shared_mutex> lock(s.mutex);
+        return s.map.erase_right(right);
+      }
+    }
+    return false;
+  }
+
+  std::optional<Right> find_left(Left const &left) const {
+    shard const &s = shard_of(left);
+    std::shared_lock<std::shared_mutex> lock(s.mutex);
+    auto it = s.map.find_left(left);
+    if (it == s.map.end_left()) {
+      return std::nullopt;
+    }
+    return *it.flip();
+  }
+
+  // right keys are scattered across shards, so this probes each in turn
+  std::optional<Left> find_right(Right const &right) const {
+    for (shard const &s : shards_) {
+      std::shared_lock<std::shared_mutex> lock(s.mutex);
+      auto it = s.map.find_right(right);
+      if (it != s.map.end_right()) {
+        return *it.flip();
+      }
+    }
+    return std::nullopt;
+  }
+
+  // a snapshot: concurrent writers may change it before the caller looks
+  std::size_t size() const {
+    std::size_t res = 0;
+    for (shard const &s : shards_) {
+      std::shared_lock<std::shared_mutex> lock(s.mutex);
+      res += s.map.size();
+    }
+    return res;
+  }
+
+  bool empty() const { return size() == 0; }
+
+private:
+  struct shard {
+    mutable std::shared_mutex mutex;
+    map_t map;
+  };
+
+  shard &shard_of(Left const &left) {
+    return shards_[hash_(left) % Shards];
+  }
+
+  shard const &shard_of(Left const &left) const {
+    return shards_[hash_(left) % Shards];
+  }
+
+  std::array<shard, Shards> shards_;
+  Hash hash_;
+  // serializes all mutations; shard locks alone cannot order the cross-shard
+  // right-key uniqueness check against a concurrent insert
+  std::mutex write_mutex_;
+};
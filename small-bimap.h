@@ -0,0 +1,254 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Small-map facade over bimap for the many-tiny-maps case.
+//
+// Up to N pairs live in one inline sorted-by-left array with a small index
+// permutation sorted by right: no allocations at all, lookups are a binary
+// search over a couple of cache lines instead of a pointer-chasing treap
+// descent. Crossing the threshold promotes the contents into a real bimap
+// (batch insert, one shot) and every later call delegates; the map never
+// demotes, shrinking tenants are rare and the arrays would have to be
+// rebuilt on every boundary crossing otherwise.
+//
+// Node-based guarantees do not survive the array form, so the API returns
+// pointers instead of iterators; they are invalidated by any mutation.
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>, std::size_t N = 32>
+struct small_bimap {
+  static_assert(N > 0 && N <= 255, "inline indices are stored in one byte");
+
+  using left_t = Left;
+  using right_t = Right;
+  using map_t = bimap<Left, Right, CompareLeft, CompareRight>;
+
+  explicit small_bimap(CompareLeft compare_left = CompareLeft(),
+                       CompareRight compare_right = CompareRight())
+      : cmp_left_(std::move(compare_left)),
+        cmp_right_(std::move(compare_right)) {}
+
+  small_bimap(small_bimap const &) = delete;
+  small_bimap &operator=(small_bimap const &) = delete;
+
+  ~small_bimap() {
+    for (std::size_t i = 0; i < count_; i++) {
+      items()[i].~pair_t();
+    }
+  }
+
+  // returns false and changes nothing if either key is already present
+  bool insert(left_t left, right_t right) {
+    if (big_) {
+      return big_->insert(std::move(left), std::move(right)) !=
+             big_->end_left();
+    }
+    std::size_t pos_l = left_rank(left);
+    if (pos_l < count_ && !cmp_left_(left, items()[pos_l].first)) {
+      return false;
+    }
+    std::size_t pos_r = right_rank(right);
+    if (pos_r < count_ &&
+        !cmp_right_(right, items()[by_right_[pos_r]].second)) {
+      return false;
+    }
+    if (count_ == N) {
+      promote();
+      return big_->insert(std::move(left), std::move(right)) !=
+             big_->end_left();
+    }
+    if (pos_l == count_) {
+      new (items() + count_) pair_t(std::move(left), std::move(right));
+    } else {
+      new (items() + count_) pair_t(std::move(items()[count_ - 1]));
+      for (std::size_t i = count_ - 1; i > pos_l; i--) {
+        items()[i] = std::move(items()[i - 1]);
+      }
+      items()[pos_l] = pair_t(std::move(left), std::move(right));
+    }
+    // entries of the right permutation shift with the array they point into
+    for (std::size_t i = 0; i < count_; i++) {
+      if (by_right_[i] >= pos_l) {
+        ++by_right_[i];
+      }
+    }
+    for (std::size_t i = count_; i > pos_r; i--) {
+      by_right_[i] = by_right_[i - 1];
+    }
+    by_right_[pos_r] = static_cast<std::uint8_t>(pos_l);
+    ++count_;
+    return true;
+  }
+
+  bool erase_left(left_t const &left) {
+    if (big_) {
+      return big_->erase_left(left);
+    }
+    std::size_t pos = left_rank(left);
+    if (pos == count_ || cmp_left_(left, items()[pos].first)) {
+      return false;
+    }
+    erase_at(pos);
+    return true;
+  }
+
+  bool erase_right(right_t const &right) {
+    if (big_) {
+      return big_->erase_right(right);
+    }
+    std::size_t pos = right_rank(right);
+    if (pos == count_ || cmp_right_(right, items()[by_right_[pos]].second)) {
+      return false;
+    }
+    erase_at(by_right_[pos]);
+    return true;
+  }
+
+  // nullptr if absent; the pointer lives until the next mutation
+  right_t const *find_left(left_t const &left) const {
+    if (big_) {
+      auto it = big_->find_left(left);
+      return it != big_->end_left() ? &*it.flip() : nullptr;
+    }
+    std::size_t pos = left_rank(left);
+    if (pos == count_ || cmp_left_(left, items()[pos].first)) {
+      return nullptr;
+    }
+    return &items()[pos].second;
+  }
+
+  left_t const *find_right(right_t const &right) const {
+    if (big_) {
+      auto it = big_->find_right(right);
+      return it != big_->end_right() ? &*it.flip() : nullptr;
+    }
+    std::size_t pos = right_rank(right);
+    if (pos == count_ || cmp_right_(right, items()[by_right_[pos]].second)) {
+      return nullptr;
+    }
+    return &items()[by_right_[pos]].first;
+  }
+
+  right_t const &at_left(left_t const &left) const {
+    right_t const *res = find_left(left);
+    if (res == nullptr) {
+      throw std::out_of_range("Key not found");
+    }
+    return *res;
+  }
+
+  left_t const &at_right(right_t const &right) const {
+    left_t const *res = find_right(right);
+    if (res == nullptr) {
+      throw std::out_of_range("Key not found");
+    }
+    return *res;
+  }
+
+  // visits (left, right) in ascending left order
+  template <typename F> void for_each(F f) const {
+    if (big_) {
+      for (auto it = big_->begin_left(); it != big_->end_left(); ++it) {
+        f(*it, *it.flip());
+      }
+      return;
+    }
+    for (std::size_t i = 0; i < count_; i++) {
+      f(items()[i].first, items()[i].second);
+    }
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    return big_ ? big_->size() : count_;
+  }
+
+  [[nodiscard]] bool empty() const { return size() == 0; }
+
+  // true once the threshold was crossed and the treap form took over
+  [[nodiscard]] bool promoted() const { return bool(big_); }
+
+private:
+  using pair_t = std::pair<left_t, right_t>;
+
+  pair_t *items() noexcept { return reinterpret_cast<pair_t *>(slots_); }
+
+  pair_t const *items() const noexcept {
+    return reinterpret_cast<pair_t const *>(slots_);
+  }
+
+  // rank of the key in the inline left order: index of the first element
+  // with a key not less than the probe
+  std::size_t left_rank(left_t const &left) const {
+    std::size_t lo = 0, hi = count_;
+    while (lo < hi) {
+      std::size_t mid = (lo + hi) / 2;
+      if (cmp_left_(items()[mid].first, left)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  std::size_t right_rank(right_t const &right) const {
+    std::size_t lo = 0, hi = count_;
+    while (lo < hi) {
+      std::size_t mid = (lo + hi) / 2;
+      if (cmp_right_(items()[by_right_[mid]].second, right)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  void erase_at(std::size_t pos) {
+    std::size_t pos_r = 0;
+    while (by_right_[pos_r] != pos) {
+      ++pos_r;
+    }
+    for (std::size_t i = pos_r; i + 1 < count_; i++) {
+      by_right_[i] = by_right_[i + 1];
+    }
+    for (std::size_t i = 0; i + 1 < count_; i++) {
+      if (by_right_[i] > pos) {
+        --by_right_[i];
+      }
+    }
+    for (std::size_t i = pos; i + 1 < count_; i++) {
+      items()[i] = std::move(items()[i + 1]);
+    }
+    items()[count_ - 1].~pair_t();
+    --count_;
+  }
+
+  void promote() {
+    std::vector<pair_t> batch;
+    batch.reserve(count_);
+    for (std::size_t i = 0; i < count_; i++) {
+      batch.push_back(std::move(items()[i]));
+      items()[i].~pair_t();
+    }
+    count_ = 0;
+    big_.emplace(cmp_left_, cmp_right_);
+    // already sorted and unique by both keys, so the batch path is linear
+    big_->insert(std::move(batch));
+  }
+
+  CompareLeft cmp_left_;
+  CompareRight cmp_right_;
+  alignas(pair_t) unsigned char slots_[N * sizeof(pair_t)];
+  std::uint8_t by_right_[N];
+  std::size_t count_ = 0;
+  std::optional<map_t> big_;
+};
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "bimap.h"
+
+// Scaling and adversarial guardrail for the algorithmic work on bimap.
+// Separate from the gtest target so it always runs optimized: depth bounds
+// and operation counts are meaningless under sanitizers or _GLIBCXX_DEBUG.
+//
+// Usage: bimap-stress [n]   (default 10M pairs for the load scenarios)
+//
+// Asserted invariants:
+//  - sorted, reversed and duplicate-heavy loads keep both trees within
+//    4.5 * log2(n) depth — random priorities beat insertion order;
+//  - a fixed-seed mixed workload performs a pinned number of comparator
+//    calls (+-25%): an accidental extra descent in some hot path fails CI
+//    here even when correctness tests stay green.
+// Timings are printed for trend eyeballing, not asserted.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, char const *what) {
+  if (!ok) {
+    failures++;
+    std::fprintf(stderr, "FAILED: %s\n", what);
+  }
+}
+
+struct timer {
+  std::chrono::steady_clock::time_point start;
+  timer() : start(std::chrono::steady_clock::now()) {}
+  double ms() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+};
+
+using map_t = bimap<std::uint64_t, std::uint64_t>;
+
+void check_depth(map_t const &b, char const *scenario) {
+  double limit = 4.5 * std::log2(static_cast<double>(b.size()) + 2);
+  auto dl = b.depth_stats_left();
+  auto dr = b.depth_stats_right();
+  std::printf("%-18s n=%zu depth L max=%zu avg=%.1f | R max=%zu avg=%.1f "
+              "(limit %.0f)\n",
+              scenario, b.size(), dl.max_depth, dl.avg_depth, dr.max_depth,
+              dr.avg_depth, limit);
+  check(dl.max_depth <= limit, "left tree depth within 4.5*log2(n)");
+  check(dr.max_depth <= limit, "right tree depth within 4.5*log2(n)");
+}
+
+void sorted_load(std::size_t n) {
+  timer t;
+  map_t b;
+  for (std::uint64_t i = 0; i < n; i++) {
+    b.insert(i, i);
+  }
+  std::printf("sorted load:       %.0f ms\n", t.ms());
+  check(b.size() == n, "sorted load inserted everything");
+  check(*b.begin_left() == 0 && *b.nth_left(n - 1) == n - 1,
+        "sorted load extremes");
+  check_depth(b, "sorted");
+}
+
+void reversed_load(std::size_t n) {
+  timer t;
+  map_t b;
+  for (std::uint64_t i = n; i > 0; i--) {
+    b.insert(i, i);
+  }
+  std::printf("reversed load:     %.0f ms\n", t.ms());
+  check(b.size() == n, "reversed load inserted everything");
+  check_depth(b, "reversed");
+}
+
+void duplicate_heavy_load(std::size_t n) {
+  // ~100 attempts per distinct key: almost every insert is a rejected
+  // duplicate, which exercises the probe paths without growing the tree
+  std::uint64_t distinct = n / 100 + 1;
+  std::mt19937_64 e(1488228);
+  timer t;
+  map_t b;
+  for (std::size_t i = 0; i < n; i++) {
+    std::uint64_t k = e() % distinct;
+    b.insert(k, k);
+  }
+  std::printf("duplicate-heavy:   %.0f ms\n", t.ms());
+  check(b.size() <= distinct, "duplicate-heavy stays at distinct keys");
+  check(b.size() > distinct / 2, "duplicate-heavy found most keys");
+  check_depth(b, "duplicate-heavy");
+}
+
+void mixed_workload_comparisons() {
+  // fixed seed for both the operation stream and the tree priorities, so
+  // the comparator-call total is exactly reproducible run to run
+  using counted_t =
+      bimap<std::uint64_t, std::uint64_t, std::less<std::uint64_t>,
+            std::less<std::uint64_t>,
+            std::allocator<std::pair<std::uint64_t, std::uint64_t>>,
+            with_stats>;
+  std::mt19937_64 e(1488228);
+  counted_t b(std::uint64_t(1488228));
+  timer t;
+  for (std::size_t i = 0; i < 2000000; i++) {
+    std::uint64_t op = e() % 10, l = e() % 500000, r = e() % 500000;
+    if (op < 5) {
+      b.insert(l, r);
+    } else if (op < 7) {
+      b.erase_left(l);
+    } else if (op == 7) {
+      b.erase_right(r);
+    } else {
+      b.find_left(l);
+      b.find_right(r);
+    }
+  }
+  auto s = b.stats();
+  std::uint64_t comparisons = s.comparisons_left + s.comparisons_right;
+  std::printf("mixed workload:    %.0f ms, %llu comparisons, %zu live\n",
+              t.ms(), static_cast<unsigned long long>(comparisons),
+              s.live_nodes);
+  // measured baseline for this exact seed and operation mix; regenerate the
+  // number here if the workload above ever changes
+  std::uint64_t const baseline = 105256199;
+  check(comparisons > baseline * 3 / 4 && comparisons < baseline * 5 / 4,
+        "mixed-workload comparison count within 25% of baseline");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t n = 10000000;
+  if (argc > 1) {
+    n = std::strtoull(argv[1], nullptr, 10);
+  }
+  sorted_load(n);
+  reversed_load(n);
+  duplicate_heavy_load(n);
+  mixed_workload_comparisons();
+  if (failures != 0) {
+    std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all stress checks passed\n");
+  return 0;
+}
@@ -1,25 +1,85 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <limits>
-#include <random>
 #include <stdexcept>
 
-int random_priority() {
-  static std::default_random_engine generator(time(nullptr));
-  static std::uniform_int_distribution<int> distribution;
-  return distribution(generator);
-}
+// SplitMix64-based priority generator. One instance lives in each container,
+// so building many trees on many cores shares no state; the previous
+// function-local static engine put every node construction on one cache line
+struct priority_source {
+  std::uint64_t state;
+
+  priority_source() noexcept
+      : state(static_cast<std::uint64_t>(time(nullptr)) ^
+              reinterpret_cast<std::uintptr_t>(this) ^ seed_counter()) {
+    // one scrambler pass so raw seeds that differ in a few bits (or by one
+    // counter step) do not land on shifted copies of the same stream
+    state = mix();
+  }
+
+  explicit priority_source(std::uint64_t seed) noexcept : state(seed) {}
+
+  int next() noexcept {
+    // strictly below the INT_MAX sentinel owned by end nodes
+    return static_cast<int>(mix() % std::numeric_limits<int>::max());
+  }
+
+  // one 64-bit draw split into two independent priorities; containers that
+  // need a priority per tree orientation save half the generator steps
+  std::pair<int, int> next_pair() noexcept {
+    std::uint64_t z = mix();
+    return {static_cast<int>((z >> 32) % std::numeric_limits<int>::max()),
+            static_cast<int>((z & 0xffffffffull) %
+                             std::numeric_limits<int>::max())};
+  }
+
+private:
+  // time ^ this alone collides: consecutive containers at the same stack
+  // address within one second would replay the same priority stream
+  static std::uint64_t seed_counter() noexcept {
+    static std::atomic<std::uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) *
+           0xd1342543de82ef95ull;
+  }
+
+  std::uint64_t mix() noexcept {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+};
 
 template <typename T, typename Tag> struct node_tree {
   node_tree *parent = nullptr;
   node_tree *left = nullptr;
   node_tree *right = nullptr;
 
-  int priority = random_priority();
+  // in-order neighbours, kept as a circular list through the end node;
+  // full scans follow one pointer per step instead of chasing the tree
+  node_tree *succ = nullptr;
+  node_tree *pred = nullptr;
+
+  // assigned by the owning container before the node enters a tree
+  int priority = 0;
+
+  // number of nodes in this subtree; powers rank/nth-element queries.
+  // 32 bits still allows 4G nodes per tree
+  std::uint32_t size = 1;
 
   explicit node_tree() = default;
 
-  node_tree *next() noexcept {
+  node_tree *next() noexcept { return succ; }
+
+  node_tree *prev() noexcept { return pred; }
+
+  // tree-walking variants; the only valid choice while the successor list
+  // is not threaded yet (e.g. right after a bulk structural merge)
+  node_tree *tree_next() noexcept {
     node_tree *cur = this;
     if (cur->right == nullptr) {
       auto par = cur->parent;
@@ -36,7 +96,7 @@ template <typename T, typename Tag> struct node_tree {
     return cur;
   }
 
-  node_tree *prev() noexcept {
+  node_tree *tree_prev() noexcept {
     node_tree *cur = this;
     if (cur->left == nullptr) {
       auto par = cur->parent;
@@ -63,17 +123,30 @@ template <typename T, typename Comparator, typename Tag> struct treap {
     // memory control is on treap user
     node_t_ *end_elem = nullptr;
 
+    // last node returned by a finger-mode lookup; nullptr when unknown.
+    // Only the finger-search entry points read it, so plain trees pay one
+    // idle pointer per side
+    mutable node_t_ *finger = nullptr;
+
     treap_storage() : Comparator() {}
 
     treap_storage(treap_storage const &other) = default;
 
-    treap_storage(treap_storage &&other) noexcept { swap(other); }
+    // steals the end pointer; the owner has to rebind the moved-from
+    // storage (see bimap::validate_ends) before using it again
+    treap_storage(treap_storage &&other) noexcept
+        : Comparator(std::move(static_cast<Comparator &>(other))),
+          end_elem(other.end_elem), finger(other.finger) {
+      other.finger = nullptr;
+    }
 
     treap_storage(Comparator comparator, node_t_ *end)
         : Comparator(std::move(comparator)), end_elem(end) {
       end_elem->left = nullptr;
       end_elem->right = nullptr;
       end_elem->parent = nullptr;
+      end_elem->succ = end_elem;
+      end_elem->pred = end_elem;
       end_elem->priority = std::numeric_limits<int>::max();
     }
 
@@ -82,9 +155,13 @@ template <typename T, typename Comparator, typename Tag> struct treap {
       return *this;
     }
 
+    // swaps only the trees; the successor lists still hang off the old end
+    // nodes, the owner has to re-splice them (see bimap::validate_ends)
     void swap(treap_storage &other) noexcept {
       std::swap<Comparator>(*this, other);
       std::swap(end_elem->left, other.end_elem->left);
+      // fingers point into the trees, which just traded owners
+      std::swap(finger, other.finger);
     }
   };
 
@@ -108,7 +185,10 @@ template <typename T, typename Comparator, typename Tag> struct treap {
 
   inline node_t_ *root() const { return last()->left; }
 
-  bool less(const T &key1, const T &key2) const noexcept {
+  // heterogeneous on purpose: with a transparent comparator lookups may
+  // probe with a key-like type (e.g. string_view against string keys)
+  template <typename K1, typename K2>
+  bool less(const K1 &key1, const K2 &key2) const noexcept {
     return (static_cast<const Comparator &>(storage))(key1, key2);
   }
 
@@ -117,76 +197,363 @@ template <typename T, typename Comparator, typename Tag> struct treap {
       child->parent = parent;
   }
 
+  static inline std::size_t size_of(const node_t_ *node) noexcept {
+    return node == nullptr ? 0 : node->size;
+  }
+
+  static inline void update_size(node_t_ *node) noexcept {
+    node->size =
+        static_cast<std::uint32_t>(1 + size_of(node->left) + size_of(node->right));
+  }
+
   // a "static" operation (uses only cmp from *this)
+  // iterative: descends once, threading the two result spines as it goes;
+  // both returned roots get a null parent
   template <typename Getter>
   std::pair<node_t_ *, node_t_ *> split(node_t_ *node, const T &key,
                                         Getter getter) noexcept {
-    if (node == nullptr) {
-      return std::pair(nullptr, nullptr);
+    node_t_ *left_res = nullptr;
+    node_t_ *right_res = nullptr;
+    node_t_ *left_tail = nullptr;
+    node_t_ *right_tail = nullptr;
+    while (node != nullptr) {
+      if (less(getter(node), key)) { // (key > node->key)
+        if (left_tail == nullptr) {
+          left_res = node;
+          node->parent = nullptr;
+        } else {
+          left_tail->right = node;
+          node->parent = left_tail;
+        }
+        left_tail = node;
+        node = node->right;
+      } else {
+        if (right_tail == nullptr) {
+          right_res = node;
+          node->parent = nullptr;
+        } else {
+          right_tail->left = node;
+          node->parent = right_tail;
+        }
+        right_tail = node;
+        node = node->left;
+      }
+    }
+    if (left_tail != nullptr) {
+      left_tail->right = nullptr;
+    }
+    if (right_tail != nullptr) {
+      right_tail->left = nullptr;
     }
-    if (less(getter(node), key)) { // (key > node->key)
-      auto split_r = split(node->right, key, getter);
-      node->right = split_r.first;
-      set_parent(split_r.first, node);
-      set_parent(split_r.second, nullptr);
-      return std::pair(node, split_r.second);
+    // only the two descent spines changed; their roots have null parents now
+    for (node_t_ *n = left_tail; n != nullptr; n = n->parent) {
+      update_size(n);
     }
-    auto split_l = split(node->left, key, getter);
-    node->left = split_l.second;
-    set_parent(split_l.second, node);
-    set_parent(split_l.first, nullptr);
-    return std::pair(split_l.first, node);
+    for (node_t_ *n = right_tail; n != nullptr; n = n->parent) {
+      update_size(n);
+    }
+    return std::pair(left_res, right_res);
   }
 
   // all keys in tree1 are expected to be < than all keys in tree2
+  // iterative: picks roots by priority, filling one child slot per step;
+  // the merged root keeps its old parent pointer (callers reattach it)
   static node_t_ *merge(node_t_ *tree1, node_t_ *tree2) {
-    if (tree2 == nullptr)
-      return tree1;
-    if (tree1 == nullptr)
-      return tree2;
-
-    if (tree1->priority > tree2->priority) {
-      tree1->right = merge(tree1->right, tree2);
-      set_parent(tree1->right, tree1);
-      return tree1;
+    node_t_ *root = nullptr;
+    node_t_ *tail = nullptr;
+    bool to_right = false; // slot of tail the next subtree attaches to
+    while (tree1 != nullptr && tree2 != nullptr) {
+      node_t_ *pick;
+      bool from_first = tree1->priority > tree2->priority;
+      if (from_first) {
+        pick = tree1;
+        tree1 = tree1->right;
+      } else {
+        pick = tree2;
+        tree2 = tree2->left;
+      }
+      if (tail == nullptr) {
+        root = pick;
+      } else if (to_right) {
+        tail->right = pick;
+        pick->parent = tail;
+      } else {
+        tail->left = pick;
+        pick->parent = tail;
+      }
+      tail = pick;
+      to_right = from_first;
+    }
+    node_t_ *rest = tree1 != nullptr ? tree1 : tree2;
+    if (tail == nullptr) {
+      return rest;
+    }
+    if (to_right) {
+      tail->right = rest;
+    } else {
+      tail->left = rest;
+    }
+    set_parent(rest, tail);
+    // the picked nodes form one parent chain from tail up to root; stop at
+    // root, whose own (stale) parent belongs to the caller
+    for (node_t_ *n = tail;; n = n->parent) {
+      update_size(n);
+      if (n == root) {
+        break;
+      }
     }
-    tree2->left = merge(tree1, tree2->left);
-    set_parent(tree2->left, tree2);
-    return tree2;
+    return root;
   }
 
   // a "static" operation (uses only cmp from this)
   // returns "new" treap;  non null node expected
+  // iterative: one descent to the priority position, then a split there
   template <typename Getter>
   node_t_ *insert(node_t_ *tree, node_t_ *node, Getter getter) noexcept {
-    if (tree == nullptr)
-      return node;
-    if (node->priority > tree->priority) {
-      auto split_tree = split(tree, getter(node), getter);
-      node->left = split_tree.first;
-      set_parent(split_tree.first, node);
-      node->right = split_tree.second;
-      set_parent(split_tree.second, node);
+    node_t_ *par = nullptr;
+    bool to_left = false;
+    node_t_ *cur = tree;
+    while (cur != nullptr && cur->priority >= node->priority) {
+      par = cur;
+      if (less(getter(node), getter(cur))) {
+        to_left = true;
+        cur = cur->left;
+      } else {
+        to_left = false;
+        cur = cur->right;
+      }
+    }
+    auto parts = split(cur, getter(node), getter);
+    node->left = parts.first;
+    set_parent(parts.first, node);
+    node->right = parts.second;
+    set_parent(parts.second, node);
+    update_size(node);
+    if (par == nullptr) {
       return node;
     }
-    if (less(getter(node), getter(tree))) {
-      tree->left = insert(tree->left, node, getter);
-      tree->left->parent = tree;
-      return tree;
+    node->parent = par;
+    if (to_left) {
+      par->left = node;
+    } else {
+      par->right = node;
+    }
+    for (node_t_ *n = par;; n = n->parent) {
+      update_size(n);
+      if (n == tree) {
+        break;
+      }
     }
-    tree->right = insert(tree->right, node, getter);
-    tree->right->parent = tree;
     return tree;
   }
 
   template <typename Getter> void insert(node_t_ *node, Getter getter) {
     last()->left = insert(root(), node, getter);
     reconnect_end();
+    relink(node);
+  }
+
+  // splices a node that is already in the tree (but not in the successor
+  // list) right after its in-order predecessor
+  void relink(node_t_ *node) noexcept {
+    node_t_ *p = node->tree_prev();
+    if (p == nullptr) {
+      p = last();
+    }
+    node->succ = p->succ;
+    node->pred = p;
+    node->succ->pred = node;
+    p->succ = node;
+  }
+
+  // result of a single-descent uniqueness probe: when the key is already
+  // present "found" points to its node, otherwise "parent"/"to_left" describe
+  // the leaf slot where a node with this key can be attached
+  struct probe_result {
+    node_t_ *parent = nullptr;
+    node_t_ *found = nullptr;
+    bool to_left = false;
+  };
+
+  // one descent: checks uniqueness and captures the insertion point at once
+  template <typename Getter>
+  probe_result find_insert_pos(const T &key, Getter getter) const noexcept {
+    probe_result res;
+    res.parent = last();
+    res.to_left = true;
+    node_t_ *cur = root();
+    if (cur != nullptr) {
+      // boundary fast paths: time-ordered ingest appends the new maximum
+      // almost every time, and the extremes are one threaded-list hop away.
+      // One comparison instead of a full descent; together with insert_at's
+      // spine rotations a sorted load is amortized O(1) per insert
+      node_t_ *max = last()->pred;
+      if (less(getter(max), key)) {
+        res.parent = max;
+        res.to_left = false;
+        return res;
+      }
+      node_t_ *min = last()->succ;
+      if (less(key, getter(min))) {
+        res.parent = min;
+        return res;
+      }
+    }
+    while (cur != nullptr) {
+      if (less(getter(cur), key)) {
+        res.parent = cur;
+        res.to_left = false;
+        cur = cur->right;
+      } else if (less(key, getter(cur))) {
+        res.parent = cur;
+        res.to_left = true;
+        cur = cur->left;
+      } else {
+        res.found = cur;
+        return res;
+      }
+    }
+    return res;
+  }
+
+  // attaches node at the slot captured by find_insert_pos and rotates it up
+  // to its priority position; makes no comparisons, so the slot stays usable
+  // after probing (but not after mutating) other trees
+  void insert_at(probe_result const &pos, node_t_ *node) noexcept {
+    node->left = nullptr;
+    node->right = nullptr;
+    node->size = 1;
+    node->parent = pos.parent;
+    for (node_t_ *n = pos.parent; n != last(); n = n->parent) {
+      ++n->size;
+    }
+    if (pos.to_left) {
+      pos.parent->left = node;
+    } else {
+      pos.parent->right = node;
+    }
+    // a node attached into a free left slot is the immediate predecessor of
+    // its parent and vice versa; rotations below do not change the order
+    node->succ = pos.to_left ? pos.parent : pos.parent->succ;
+    node->pred = pos.to_left ? pos.parent->pred : pos.parent;
+    node->succ->pred = node;
+    node->pred->succ = node;
+    // end_elem has maximal priority, so the loop stops there naturally
+    while (node->parent->priority < node->priority) {
+      rotate_up(node);
+    }
+  }
+
+  // linear stack-based build from node pointers already in ascending key
+  // order; keeps the right spine of the growing tree and walks it up by
+  // priority, which is amortized O(n) overall
+  template <typename It>
+  static node_t_ *build_sorted(It first, It last) noexcept {
+    node_t_ *root = nullptr;
+    node_t_ *spine = nullptr; // deepest node of the current right spine
+    for (It it = first; it != last; ++it) {
+      node_t_ *node = *it;
+      node->left = nullptr;
+      node->right = nullptr;
+      node->parent = nullptr;
+      node->size = 1;
+      // a popped node's subtree is complete, so its size can be finalized
+      while (spine != nullptr && spine->priority < node->priority) {
+        update_size(spine);
+        spine = spine->parent;
+      }
+      if (spine == nullptr) {
+        node->left = root;
+        set_parent(root, node);
+        root = node;
+      } else {
+        node->left = spine->right;
+        set_parent(node->left, node);
+        spine->right = node;
+        node->parent = spine;
+      }
+      spine = node;
+    }
+    for (node_t_ *n = spine; n != nullptr; n = n->parent) {
+      update_size(n);
+    }
+    return root;
+  }
+
+  // replaces the whole tree with one built from ordered node pointers
+  template <typename It> void assign_ordered(It first, It last) noexcept {
+    storage.finger = nullptr; // the previous tree is gone wholesale
+    storage.end_elem->left = build_sorted(first, last);
+    reconnect_end();
+    // the input is already in order: chain the successor list in one pass
+    node_t_ *prev = storage.end_elem;
+    for (It it = first; it != last; ++it) {
+      node_t_ *node = *it;
+      node->pred = prev;
+      prev->succ = node;
+      prev = node;
+    }
+    prev->succ = storage.end_elem;
+    storage.end_elem->pred = prev;
+  }
+
+  // merges a detached tree whose keys are disjoint from ours into this one;
+  // O(m log(n/m)) expected for m merged into n nodes
+  // the merged-in nodes are not threaded into the successor list; the caller
+  // relinks them (it knows the batch, we do not)
+  template <typename Getter> void unite(node_t_ *other, Getter getter) {
+    last()->left = unite_impl(root(), other, getter);
+    reconnect_end();
+  }
+
+  // detaches all nodes with keys >= lo in two descents and returns the
+  // detached subtree (its parent is reset to null)
+  template <typename Getter>
+  node_t_ *extract_lower(const T &lo, Getter getter) noexcept {
+    storage.finger = nullptr; // may end up inside the detached part
+    auto lower = split(root(), lo, getter);
+    last()->left = lower.first;
+    reconnect_end();
+    unthread(lower.second);
+    return lower.second;
+  }
+
+  // same for keys in [lo, hi)
+  template <typename Getter>
+  node_t_ *extract_range(const T &lo, const T &hi, Getter getter) noexcept {
+    storage.finger = nullptr;
+    auto lower = split(root(), lo, getter);
+    auto upper = split(lower.second, hi, getter);
+    last()->left = merge(lower.first, upper.second);
+    reconnect_end();
+    unthread(upper.first);
+    return upper.first;
+  }
+
+  // a detached subtree holds a contiguous key range, so cutting it out of
+  // the successor list is one splice around its extremes
+  static void unthread(node_t_ *detached) noexcept {
+    if (detached == nullptr) {
+      return;
+    }
+    node_t_ *lo = detached;
+    while (lo->left != nullptr) {
+      lo = lo->left;
+    }
+    node_t_ *hi = detached;
+    while (hi->right != nullptr) {
+      hi = hi->right;
+    }
+    lo->pred->succ = hi->succ;
+    hi->succ->pred = lo->pred;
   }
 
   // node of the tree expected
   node_t_ *remove(node_t_ *tree, node_t_ *node) {
     node_t_ *par = node->parent;
+    for (node_t_ *n = par; n != last(); n = n->parent) {
+      --n->size;
+    }
     node_t_ *res = merge(node->left, node->right);
     set_parent(res, par);
     if (par == last()) {
@@ -201,8 +568,57 @@ template <typename T, typename Comparator, typename Tag> struct treap {
     return tree;
   }
 
+  // fused keyed removal: a single descent decrements subtree sizes on the
+  // way down and unlinks the node right where the key matches, so a hit
+  // pays no parent climb and no second traversal. Returns the detached
+  // node, or nullptr (after giving the provisional decrements back) on a
+  // miss — misses are rare in eviction-style workloads
+  template <typename K, typename Getter>
+  node_t_ *remove_key(const K &key, Getter getter) noexcept {
+    node_t_ *prev = last();
+    node_t_ *cur = root();
+    while (cur != nullptr) {
+      --cur->size;
+      if (less(getter(cur), key)) {
+        prev = cur;
+        cur = cur->right;
+      } else if (less(key, getter(cur))) {
+        prev = cur;
+        cur = cur->left;
+      } else {
+        break;
+      }
+    }
+    if (cur == nullptr) {
+      for (node_t_ *n = prev; n != last(); n = n->parent) {
+        ++n->size;
+      }
+      return nullptr;
+    }
+    if (storage.finger == cur) {
+      storage.finger = is_last(cur->pred) ? nullptr : cur->pred;
+    }
+    cur->pred->succ = cur->succ;
+    cur->succ->pred = cur->pred;
+    node_t_ *par = cur->parent;
+    node_t_ *sub = merge(cur->left, cur->right);
+    set_parent(sub, par);
+    if (par->left == cur) {
+      par->left = sub;
+    } else {
+      par->right = sub;
+    }
+    return cur;
+  }
+
   node_t_ *remove(node_t_ *node) {
-    auto res = node->next();
+    auto res = node->succ;
+    if (storage.finger == node) {
+      // the predecessor keeps the locality for scan-and-erase loops
+      storage.finger = is_last(node->pred) ? nullptr : node->pred;
+    }
+    node->pred->succ = node->succ;
+    node->succ->pred = node->pred;
     last()->left = remove(root(), node);
     reconnect_end();
     return res;
@@ -213,8 +629,8 @@ template <typename T, typename Comparator, typename Tag> struct treap {
     remove(node);
   }
 
-  template <typename Getter>
-  node_t_ *find(const T &key, node_t_ *node, Getter getter) const noexcept {
+  template <typename K, typename Getter>
+  node_t_ *find(const K &key, node_t_ *node, Getter getter) const noexcept {
     while (node != nullptr) {
       if (less(getter(node), key)) {
         node = node->right;
@@ -227,13 +643,69 @@ template <typename T, typename Comparator, typename Tag> struct treap {
     return last();
   }
 
-  template <typename Getter>
-  node_t_ *find(const T &key, Getter getter) const noexcept {
+  template <typename K, typename Getter>
+  node_t_ *find(const K &key, Getter getter) const noexcept {
     return find(key, root(), getter);
   }
 
-  template <typename Getter>
-  node_t_ *lower_bound(const T &key, node_t_ *node,
+  // grows the subtree around the finger until its key region provably
+  // contains the probe, then hands that subtree back as the descent origin;
+  // O(log d) expected for inter-access distance d. Once some subtree key is
+  // <= the probe, the region's lower bound stays below the probe in every
+  // enclosing subtree too (and symmetrically for >=), so two sticky flags
+  // are enough to know when to stop climbing
+  template <typename K, typename Getter>
+  node_t_ *finger_origin(const K &key, Getter getter) const noexcept {
+    node_t_ *cur = storage.finger;
+    if (cur == nullptr) {
+      return root();
+    }
+    bool lo_ok = !less(key, getter(cur)); // saw a subtree key <= probe
+    bool hi_ok = !less(getter(cur), key); // saw a subtree key >= probe
+    while (!(lo_ok && hi_ok) && !is_last(cur->parent)) {
+      cur = cur->parent;
+      lo_ok = lo_ok || !less(key, getter(cur));
+      hi_ok = hi_ok || !less(getter(cur), key);
+    }
+    return cur;
+  }
+
+  // find that starts near the previous hit instead of the root; the caller
+  // opts in (see bimap's finger_search policy flag). Updating the mutable
+  // finger makes this unsafe to share between threads, like any hinted cache
+  template <typename K, typename Getter>
+  node_t_ *find_finger(const K &key, Getter getter) const noexcept {
+    node_t_ *res = find(key, finger_origin(key, getter), getter);
+    if (!is_last(res)) {
+      storage.finger = res;
+    }
+    return res;
+  }
+
+  template <typename K, typename Getter>
+  node_t_ *lower_bound_finger(const K &key, Getter getter) const noexcept {
+    node_t_ *origin = finger_origin(key, getter);
+    node_t_ *res = lower_bound(key, origin, getter);
+    if (is_last(res) && origin != nullptr) {
+      // the whole origin subtree is below the probe (only possible when the
+      // climb ran out at the root, or the true bound is the first ancestor
+      // holding the subtree on its left)
+      node_t_ *cur = origin;
+      while (!is_last(cur->parent) && cur->parent->right == cur) {
+        cur = cur->parent;
+      }
+      if (!is_last(cur->parent)) {
+        res = cur->parent;
+      }
+    }
+    if (!is_last(res)) {
+      storage.finger = res;
+    }
+    return res;
+  }
+
+  template <typename K, typename Getter>
+  node_t_ *lower_bound(const K &key, node_t_ *node,
                        Getter getter) const noexcept {
     node_t_ *res = nullptr;
     while (node != nullptr) {
@@ -250,13 +722,13 @@ template <typename T, typename Comparator, typename Tag> struct treap {
     return res;
   }
 
-  template <typename Getter>
-  node_t_ *lower_bound(const T &key, Getter getter) const noexcept {
+  template <typename K, typename Getter>
+  node_t_ *lower_bound(const K &key, Getter getter) const noexcept {
     return lower_bound(key, root(), getter);
   }
 
-  template <typename Getter>
-  node_t_ *upper_bound(const T &key, node_t_ *node,
+  template <typename K, typename Getter>
+  node_t_ *upper_bound(const K &key, node_t_ *node,
                        Getter getter) const noexcept {
     node_t_ *res = nullptr;
     while (node != nullptr) {
@@ -273,19 +745,102 @@ template <typename T, typename Comparator, typename Tag> struct treap {
     return res;
   }
 
-  template <typename Getter>
-  node_t_ *upper_bound(const T &key, Getter getter) const noexcept {
+  template <typename K, typename Getter>
+  node_t_ *upper_bound(const K &key, Getter getter) const noexcept {
     return upper_bound(key, root(), getter);
   }
 
-  node_t_ *first() const noexcept {
-    auto res = last();
-    while (res->left != nullptr) {
-      res = res->left;
+  // both bounds of [lo, hi) from one descent: the shared prefix of the two
+  // lower_bound walks is taken once, and the partial descents only start
+  // where the paths fork
+  template <typename K1, typename K2, typename Getter>
+  std::pair<node_t_ *, node_t_ *> equal_range(const K1 &lo, const K2 &hi,
+                                              Getter getter) const noexcept {
+    node_t_ *res = last(); // first node >= hi above the fork
+    node_t_ *node = root();
+    while (node != nullptr) {
+      if (less(getter(node), lo)) {
+        node = node->right;
+      } else if (!less(getter(node), hi)) {
+        res = node;
+        node = node->left;
+      } else {
+        // lo <= node < hi: the bound walks diverge into the two subtrees
+        node_t_ *first = lower_bound(lo, node->left, getter);
+        if (is_last(first)) {
+          first = node;
+        }
+        node_t_ *second = lower_bound(hi, node->right, getter);
+        if (is_last(second)) {
+          second = res;
+        }
+        return std::pair(first, second);
+      }
+    }
+    return std::pair(res, res); // empty range
+  }
+
+  // number of keys in [lo, hi); two rank descents, no iteration
+  template <typename K1, typename K2, typename Getter>
+  std::size_t count_range(const K1 &lo, const K2 &hi,
+                          Getter getter) const noexcept {
+    std::size_t lo_rank = rank(lo, getter);
+    std::size_t hi_rank = rank(hi, getter);
+    return hi_rank > lo_rank ? hi_rank - lo_rank : 0;
+  }
+
+  // k-th smallest node, 0-based; last() if k is out of range
+  node_t_ *nth(std::size_t k) const noexcept {
+    node_t_ *node = root();
+    if (node == nullptr || k >= node->size) {
+      return last();
+    }
+    while (true) {
+      std::size_t left_size = size_of(node->left);
+      if (k < left_size) {
+        node = node->left;
+      } else if (k == left_size) {
+        return node;
+      } else {
+        k -= left_size + 1;
+        node = node->right;
+      }
+    }
+  }
+
+  // number of keys less than key
+  template <typename K, typename Getter>
+  std::size_t rank(const K &key, Getter getter) const noexcept {
+    std::size_t res = 0;
+    node_t_ *node = root();
+    while (node != nullptr) {
+      if (less(getter(node), key)) {
+        res += size_of(node->left) + 1;
+        node = node->right;
+      } else {
+        node = node->left;
+      }
+    }
+    return res;
+  }
+
+  // 0-based position of a node of this tree (tree size for last());
+  // O(log n) and comparison-free, it only climbs parents
+  std::size_t order_of(const node_t_ *node) const noexcept {
+    if (is_last(node)) {
+      return size_of(root());
+    }
+    std::size_t res = size_of(node->left);
+    for (const node_t_ *cur = node; !is_last(cur->parent); cur = cur->parent) {
+      if (cur->parent->right == cur) {
+        res += size_of(cur->parent->left) + 1;
+      }
     }
     return res;
   }
 
+  node_t_ *first() const noexcept { return last()->succ; }
+
   node_t_ *last() const noexcept { return storage.end_elem; }
 
   inline bool is_last(node_t_ const *node) const noexcept {
@@ -294,4 +849,49 @@ template <typename T, typename Comparator, typename Tag> struct treap {
 
 private:
   inline void reconnect_end() noexcept { set_parent(last()->left, last()); }
+
+  // classic treap union: the higher-priority root wins, the other tree is
+  // split by its key; recursion depth is the expected O(log (n + m))
+  template <typename Getter>
+  node_t_ *unite_impl(node_t_ *a, node_t_ *b, Getter getter) noexcept {
+    if (a == nullptr) {
+      return b;
+    }
+    if (b == nullptr) {
+      return a;
+    }
+    if (a->priority < b->priority) {
+      std::swap(a, b);
+    }
+    auto parts = split(b, getter(a), getter);
+    a->left = unite_impl(a->left, parts.first, getter);
+    set_parent(a->left, a);
+    a->right = unite_impl(a->right, parts.second, getter);
+    set_parent(a->right, a);
+    update_size(a);
+    return a;
+  }
+
+  static void rotate_up(node_t_ *node) noexcept {
+    node_t_ *par = node->parent;
+    node_t_ *grand = par->parent;
+    if (par->left == node) {
+      par->left = node->right;
+      set_parent(node->right, par);
+      node->right = par;
+    } else {
+      par->right = node->left;
+      set_parent(node->left, par);
+      node->left = par;
+    }
+    par->parent = node;
+    node->parent = grand;
+    if (grand->left == par) {
+      grand->left = node;
+    } else {
+      grand->right = node;
+    }
+    update_size(par);
+    update_size(node);
+  }
 };